@@ -12,12 +12,8 @@
 #define EARTH_ECCENT2 0.0067394         /* Eccentricity of earth elipsoid 2 */
 
 
-static double _ROC_Longitude_;  // Geocentric longitude [degrees]
-static double _ROC_Latitude_;   // Geocentric latitude [degrees]
-static double _ROC_Altitude_;   // Geocentric altitude [meters]
-
-static double _ROC_GEOCENTRIC_MATRIX_[3][3];  // Geocentric rotation matrix
-static double _ROC_GEOCENTRIC_POLAR_[3];      // Geocentric polar coordinates
+// Context of the functions without context argument
+static ROC_CONTEXT _ROC_CONTEXT_;
 
 // Initialize geocentric coordinates and matrices here
 /***********************************************************************
@@ -36,23 +32,32 @@ static double _ROC_GEOCENTRIC_POLAR_[3];      // Geocentric polar coordinates
  *
  *  Return Value:	None.
  ***********************************************************************/
-void Init_CoordinateTransformation(double Longitude, /* ROC Longitude */
+void Init_CoordinateTransformation(ROC_CONTEXT *Context,
+                                   double Longitude, /* ROC Longitude */
                                    double Latitude,  /* ROC Latitude */
                                    double Altitude)  /* ROC Altitude */
 {
-    _ROC_Longitude_ = Longitude; /* * ONEPI/180.0;*/
-    _ROC_Latitude_ = Latitude;   /* * ONEPI/180.0;*/
-    _ROC_Altitude_ = Altitude;
+    Context->ROC_Longitude = Longitude; /* * ONEPI/180.0;*/
+    Context->ROC_Latitude = Latitude;   /* * ONEPI/180.0;*/
+    Context->ROC_Altitude = Altitude;
 
-    Coordinate_Transform_Init_ROC_Location(_ROC_Longitude_, _ROC_Latitude_, _ROC_Altitude_);
+    Coordinate_Transform_Init_ROC_Location(Context, Context->ROC_Longitude, Context->ROC_Latitude,
+                                           Context->ROC_Altitude);
+}
+
+void Init_CoordinateTransformation(double Longitude, /* ROC Longitude */
+                                   double Latitude,  /* ROC Latitude */
+                                   double Altitude)  /* ROC Altitude */
+{
+    Init_CoordinateTransformation(&_ROC_CONTEXT_, Longitude, Latitude, Altitude);
 }
 
 /************************************************************************
  *	Function Name:	Coordinate_Transform_Init_ROC_Location
  *
- *  Description:	Given ROC location, precompute _ROC_GEOCENTRIC_MATRIX_
- *					and _ROC_GEOCENTRIC_POLAR_, and
- *					save in some static variables.
+ *  Description:	Given ROC location, precompute geocentric matrix
+ *					and geocentric polar vector, and
+ *					save in the context.
  *
  *  Arguments:			name	in/out	type	description
  *					---------------------------------------------
@@ -61,10 +66,14 @@ void Init_CoordinateTransformation(double Longitude, /* ROC Longitude */
  *
  *  Return Value:	None.
  ********************************************************************/
-void Coordinate_Transform_Init_ROC_Location(double Longitude, /* ROC Longitude */
+void Coordinate_Transform_Init_ROC_Location(ROC_CONTEXT *Context,
+                                            double Longitude, /* ROC Longitude */
                                             double Latitude,  /* ROC Latitude  */
                                             double Altitude)  /* ROC Altitude */
 {
+    double(*Matrix)[3] = Context->ROC_Geocentric_Matrix;
+    double *Polar = Context->ROC_Geocentric_Polar;
+
     /* 'ROC_Lat_Geocent' is ROC lat of geocentric */
     double ROC_Lat_Geocent = atan(tan(Latitude) / (1 + EARTH_ECCENT2));
     double sin_Long = sin(Longitude);
@@ -75,35 +84,42 @@ void Coordinate_Transform_Init_ROC_Location(double Longitude, /* ROC Longitude *
 
     /* the matrix to transport from earth coordinates to geocentric coordinates*/
 #ifdef SYSTEM_SAEW
-    _ROC_GEOCENTRIC_MATRIX_[0][0] = -sin_Lat * cos_Long;
-    _ROC_GEOCENTRIC_MATRIX_[0][1] = sin_Long;
-    _ROC_GEOCENTRIC_MATRIX_[0][2] = cos_Lat * cos_Long;
+    Matrix[0][0] = -sin_Lat * cos_Long;
+    Matrix[0][1] = sin_Long;
+    Matrix[0][2] = cos_Lat * cos_Long;
 
-    _ROC_GEOCENTRIC_MATRIX_[1][0] = -sin_Lat * sin_Long;
-    _ROC_GEOCENTRIC_MATRIX_[1][1] = -cos_Long;
-    _ROC_GEOCENTRIC_MATRIX_[1][2] = cos_Lat * sin_Long;
+    Matrix[1][0] = -sin_Lat * sin_Long;
+    Matrix[1][1] = -cos_Long;
+    Matrix[1][2] = cos_Lat * sin_Long;
 
-    _ROC_GEOCENTRIC_MATRIX_[2][0] = cos_Lat;
-    _ROC_GEOCENTRIC_MATRIX_[2][1] = 0;
-    _ROC_GEOCENTRIC_MATRIX_[2][2] = sin_Lat;
+    Matrix[2][0] = cos_Lat;
+    Matrix[2][1] = 0;
+    Matrix[2][2] = sin_Lat;
 #else
-    _ROC_GEOCENTRIC_MATRIX_[0][0] = -sin_Long;
-    _ROC_GEOCENTRIC_MATRIX_[0][1] = -sin_Lat * cos_Long;
-    _ROC_GEOCENTRIC_MATRIX_[0][2] = cos_Lat * cos_Long;
+    Matrix[0][0] = -sin_Long;
+    Matrix[0][1] = -sin_Lat * cos_Long;
+    Matrix[0][2] = cos_Lat * cos_Long;
 
-    _ROC_GEOCENTRIC_MATRIX_[1][0] = cos_Long;
-    _ROC_GEOCENTRIC_MATRIX_[1][1] = -sin_Lat * sin_Long;
-    _ROC_GEOCENTRIC_MATRIX_[1][2] = cos_Lat * sin_Long;
+    Matrix[1][0] = cos_Long;
+    Matrix[1][1] = -sin_Lat * sin_Long;
+    Matrix[1][2] = cos_Lat * sin_Long;
 
-    _ROC_GEOCENTRIC_MATRIX_[2][0] = 0;
-    _ROC_GEOCENTRIC_MATRIX_[2][1] = cos_Lat;
-    _ROC_GEOCENTRIC_MATRIX_[2][2] = sin_Lat;
+    Matrix[2][0] = 0;
+    Matrix[2][1] = cos_Lat;
+    Matrix[2][2] = sin_Lat;
 #endif
 
     /* the vector - Ratios from coa to center of earth */
-    _ROC_GEOCENTRIC_POLAR_[0] = Earth_Radius_ROC * _ROC_GEOCENTRIC_MATRIX_[0][2];
-    _ROC_GEOCENTRIC_POLAR_[1] = Earth_Radius_ROC * _ROC_GEOCENTRIC_MATRIX_[1][2];
-    _ROC_GEOCENTRIC_POLAR_[2] = Earth_Radius_ROC * _ROC_GEOCENTRIC_MATRIX_[2][2];
+    Polar[0] = Earth_Radius_ROC * Matrix[0][2];
+    Polar[1] = Earth_Radius_ROC * Matrix[1][2];
+    Polar[2] = Earth_Radius_ROC * Matrix[2][2];
+}
+
+void Coordinate_Transform_Init_ROC_Location(double Longitude, /* ROC Longitude */
+                                            double Latitude,  /* ROC Latitude  */
+                                            double Altitude)  /* ROC Altitude */
+{
+    Coordinate_Transform_Init_ROC_Location(&_ROC_CONTEXT_, Longitude, Latitude, Altitude);
 }
 
 /***********************************************************************
@@ -122,6 +138,7 @@ void Coordinate_Transform_Init_ROC_Location(double Longitude, /* ROC Longitude *
  *  Return Value:	None.
  **********************************************************************/
 void Coordinate_Transform_ROCInner_To_LongLat(
+    const ROC_CONTEXT *Context,
     INERTIAL_POSITION *Pos_ROCInner, /* Position in Inertial coord. sys. */
      double *Longitude,              /* Longitude  [rad]  */
      double *Latitude,               /* Latitude   [rad]  */
@@ -139,17 +156,20 @@ void Coordinate_Transform_ROCInner_To_LongLat(
     double r_xy;
 #endif
 
-    x_gcs = _ROC_GEOCENTRIC_MATRIX_[0][0] * Pos_ROCInner->Inertial_X_f +
-            _ROC_GEOCENTRIC_MATRIX_[0][1] * Pos_ROCInner->Inertial_Y_f +
-            _ROC_GEOCENTRIC_MATRIX_[0][2] * Pos_ROCInner->Inertial_Z_f + _ROC_GEOCENTRIC_POLAR_[0];
+    const double(*Matrix)[3] = Context->ROC_Geocentric_Matrix;
+    const double *Polar = Context->ROC_Geocentric_Polar;
 
-    y_gcs = _ROC_GEOCENTRIC_MATRIX_[1][0] * Pos_ROCInner->Inertial_X_f +
-            _ROC_GEOCENTRIC_MATRIX_[1][1] * Pos_ROCInner->Inertial_Y_f +
-            _ROC_GEOCENTRIC_MATRIX_[1][2] * Pos_ROCInner->Inertial_Z_f + _ROC_GEOCENTRIC_POLAR_[1];
+    x_gcs = Matrix[0][0] * Pos_ROCInner->Inertial_X_f +
+            Matrix[0][1] * Pos_ROCInner->Inertial_Y_f +
+            Matrix[0][2] * Pos_ROCInner->Inertial_Z_f + Polar[0];
 
-    z_gcs = _ROC_GEOCENTRIC_MATRIX_[2][0] * Pos_ROCInner->Inertial_X_f +
-            _ROC_GEOCENTRIC_MATRIX_[2][1] * Pos_ROCInner->Inertial_Y_f +
-            _ROC_GEOCENTRIC_MATRIX_[2][2] * Pos_ROCInner->Inertial_Z_f + _ROC_GEOCENTRIC_POLAR_[2];
+    y_gcs = Matrix[1][0] * Pos_ROCInner->Inertial_X_f +
+            Matrix[1][1] * Pos_ROCInner->Inertial_Y_f +
+            Matrix[1][2] * Pos_ROCInner->Inertial_Z_f + Polar[1];
+
+    z_gcs = Matrix[2][0] * Pos_ROCInner->Inertial_X_f +
+            Matrix[2][1] * Pos_ROCInner->Inertial_Y_f +
+            Matrix[2][2] * Pos_ROCInner->Inertial_Z_f + Polar[2];
 
     r2_xy = x_gcs * x_gcs + y_gcs * y_gcs;
     r2_xyz = r2_xy + z_gcs * z_gcs;
@@ -183,6 +203,17 @@ void Coordinate_Transform_ROCInner_To_LongLat(
     *Radaius = Earth_Radius;
 }
 
+void Coordinate_Transform_ROCInner_To_LongLat(
+    INERTIAL_POSITION *Pos_ROCInner, /* Position in Inertial coord. sys. */
+     double *Longitude,              /* Longitude  [rad]  */
+     double *Latitude,               /* Latitude   [rad]  */
+     double *Altitude,               /* Height above sea-level  [m]  */
+     double *Radaius)                /* Radius  [m]  */
+{
+    Coordinate_Transform_ROCInner_To_LongLat(&_ROC_CONTEXT_, Pos_ROCInner, Longitude, Latitude,
+                                             Altitude, Radaius);
+}
+
 /**********************************************************************
  *  Function Name:	Coordinate_Transform_LongLat_To_ROCInner
  *
@@ -199,11 +230,15 @@ void Coordinate_Transform_ROCInner_To_LongLat(
  *  Return Value:	None.
  **********************************************************************/
 void Coordinate_Transform_LongLat_To_ROCInner(
+    const ROC_CONTEXT *Context,
     double Longitude,                 /* Longitude  [rad]  */
     double Latitude,                  /* Latitude   [rad]  */
     double Altitude,                  /* Height above sea-level  [m]  */
      INERTIAL_POSITION *Pos_ROCInner) /* Position in Inertial coord. sys. */
 {
+    const double(*Matrix)[3] = Context->ROC_Geocentric_Matrix;
+    const double *Polar = Context->ROC_Geocentric_Polar;
+
     double Lat_Geocent = atan(tan(Latitude) / (1 + EARTH_ECCENT2));
     double sin_Long = sin(Longitude);
     double cos_Long = cos(Longitude);
@@ -217,17 +252,27 @@ void Coordinate_Transform_LongLat_To_ROCInner(
     double z_gcs = Earth_Radius * sin_Lat;
 
     Pos_ROCInner->Inertial_X_f =
-        _ROC_GEOCENTRIC_MATRIX_[0][0] * (x_gcs - _ROC_GEOCENTRIC_POLAR_[0]) +
-        _ROC_GEOCENTRIC_MATRIX_[1][0] * (y_gcs - _ROC_GEOCENTRIC_POLAR_[1]) +
-        _ROC_GEOCENTRIC_MATRIX_[2][0] * (z_gcs - _ROC_GEOCENTRIC_POLAR_[2]);
+        Matrix[0][0] * (x_gcs - Polar[0]) +
+        Matrix[1][0] * (y_gcs - Polar[1]) +
+        Matrix[2][0] * (z_gcs - Polar[2]);
 
     Pos_ROCInner->Inertial_Y_f =
-        _ROC_GEOCENTRIC_MATRIX_[0][1] * (x_gcs - _ROC_GEOCENTRIC_POLAR_[0]) +
-        _ROC_GEOCENTRIC_MATRIX_[1][1] * (y_gcs - _ROC_GEOCENTRIC_POLAR_[1]) +
-        _ROC_GEOCENTRIC_MATRIX_[2][1] * (z_gcs - _ROC_GEOCENTRIC_POLAR_[2]);
+        Matrix[0][1] * (x_gcs - Polar[0]) +
+        Matrix[1][1] * (y_gcs - Polar[1]) +
+        Matrix[2][1] * (z_gcs - Polar[2]);
 
     Pos_ROCInner->Inertial_Z_f =
-        _ROC_GEOCENTRIC_MATRIX_[0][2] * (x_gcs - _ROC_GEOCENTRIC_POLAR_[0]) +
-        _ROC_GEOCENTRIC_MATRIX_[1][2] * (y_gcs - _ROC_GEOCENTRIC_POLAR_[1]) +
-        _ROC_GEOCENTRIC_MATRIX_[2][2] * (z_gcs - _ROC_GEOCENTRIC_POLAR_[2]);
+        Matrix[0][2] * (x_gcs - Polar[0]) +
+        Matrix[1][2] * (y_gcs - Polar[1]) +
+        Matrix[2][2] * (z_gcs - Polar[2]);
+}
+
+void Coordinate_Transform_LongLat_To_ROCInner(
+    double Longitude,                 /* Longitude  [rad]  */
+    double Latitude,                  /* Latitude   [rad]  */
+    double Altitude,                  /* Height above sea-level  [m]  */
+     INERTIAL_POSITION *Pos_ROCInner) /* Position in Inertial coord. sys. */
+{
+    Coordinate_Transform_LongLat_To_ROCInner(&_ROC_CONTEXT_, Longitude, Latitude, Altitude,
+                                             Pos_ROCInner);
 }
@@ -7,6 +7,17 @@ struct INERTIAL_POSITION {
     double Inertial_Z_f;
 };
 
+/* ROC location and values precomputed for it. Functions taking the context
+ * don't touch shared state, so contexts with different ROC locations can be
+ * used by several threads at once */
+struct ROC_CONTEXT {
+    double ROC_Longitude;                /* Geocentric longitude [rad] */
+    double ROC_Latitude;                 /* Geocentric latitude [rad] */
+    double ROC_Altitude;                 /* Geocentric altitude [meters] */
+    double ROC_Geocentric_Matrix[3][3];  /* Geocentric rotation matrix */
+    double ROC_Geocentric_Polar[3];      /* Geocentric polar coordinates */
+};
+
 
 /* Temporary variables
  * Coordinate transformation and temporary variables for coordinate conversion, used for geocentric
@@ -31,3 +42,29 @@ void Coordinate_Transform_LongLat_To_ROCInner(
     double Latitude,                   /* Latitude   [rad]  */
     double Altitude,                   /* Height above sea-level  [m]  */
      INERTIAL_POSITION *Pos_ROCInner); /* Position in Inertial coord. sys. */
+
+/* Reentrant versions, the functions above use a single global context */
+void Init_CoordinateTransformation(ROC_CONTEXT *Context,
+                                   double Longitude, /* ROC Longitude */
+                                   double Latitude,  /* ROC Latitude */
+                                   double Altitude);
+
+void Coordinate_Transform_Init_ROC_Location(ROC_CONTEXT *Context,
+                                            double Longitude, /* ROC Longitude */
+                                            double Latitude,  /* ROC Latitude */
+                                            double Altitude);
+
+void Coordinate_Transform_ROCInner_To_LongLat(
+    const ROC_CONTEXT *Context,
+    INERTIAL_POSITION *Pos_ROCInner, /* Position in Inertial coord. sys. */
+     double *Longitude,              /* Longitude  [rad]  */
+     double *Latitude,               /* Latitude   [rad]  */
+     double *Altitude,               /* Height above sea-level  [m]  */
+     double *Radaius);               /* Height above sea-level  [m]  */
+
+void Coordinate_Transform_LongLat_To_ROCInner(
+    const ROC_CONTEXT *Context,
+    double Longitude,                  /* Longitude  [rad]  */
+    double Latitude,                   /* Latitude   [rad]  */
+    double Altitude,                   /* Height above sea-level  [m]  */
+     INERTIAL_POSITION *Pos_ROCInner); /* Position in Inertial coord. sys. */
@@ -0,0 +1,384 @@
+#include "gisattributetable.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+GisAttributeTable::Column::Column(const std::string& name, FieldType type, int precision,
+                                  ColumnLoader loader)
+    : name(name), type(type), precision(precision), loader(std::move(loader)) {}
+
+GisAttributeTable::GisAttributeTable() : rowsCount_(0) {}
+
+void GisAttributeTable::clear() {
+    columns_.clear();
+    rowsCount_ = 0;
+}
+
+void GisAttributeTable::clearRows() {
+    for (auto& column : columns_) {
+        column.integers.clear();
+        column.doubles.clear();
+        column.codes.clear();
+        column.nulls.clear();
+        column.dictionaryCodes.clear();
+        column.dictionary.clear();
+    }
+    rowsCount_ = 0;
+}
+
+std::size_t GisAttributeTable::addColumn(const std::string& name, FieldType type,
+                                         int precision) {
+    columns_.emplace_back(name, type, precision, nullptr);
+    addValues(columns_.back(), rowsCount_);
+
+    return columns_.size() - 1;
+}
+
+std::size_t GisAttributeTable::addLazyColumn(const std::string& name, FieldType type,
+                                             int precision, ColumnLoader loader) {
+    columns_.emplace_back(name, type, precision, std::move(loader));
+
+    return columns_.size() - 1;
+}
+
+bool GisAttributeTable::isColumnLoaded(std::size_t column) const {
+    return !columns_[column].loader;
+}
+
+void GisAttributeTable::loadColumn(std::size_t column) const {
+    if (!columns_[column].loader) {
+        return;
+    }
+
+    // Deferred values are part of the table already, loading them doesn't
+    // change what callers see.
+    auto& table = const_cast<GisAttributeTable&>(*this);
+    Column& tableColumn = table.columns_[column];
+
+    // Reset the loader first, so setters called by it see a loaded column.
+    ColumnLoader loader = std::move(tableColumn.loader);
+    tableColumn.loader = nullptr;
+    table.addValues(tableColumn, rowsCount_);
+
+    loader(table, column);
+}
+
+void GisAttributeTable::loadColumns() const {
+    for (std::size_t column = 0; column < columns_.size(); ++column) {
+        loadColumn(column);
+    }
+}
+
+std::size_t GisAttributeTable::columnsCount() const { return columns_.size(); }
+
+const std::string& GisAttributeTable::columnName(std::size_t column) const {
+    return columns_[column].name;
+}
+
+GisAttributeTable::FieldType GisAttributeTable::columnType(std::size_t column) const {
+    return columns_[column].type;
+}
+
+int GisAttributeTable::columnPrecision(std::size_t column) const {
+    return columns_[column].precision;
+}
+
+int GisAttributeTable::columnIndex(const std::string& name) const {
+    for (std::size_t column = 0; column < columns_.size(); ++column) {
+        if (columns_[column].name == name) {
+            return static_cast<int>(column);
+        }
+    }
+
+    return -1;
+}
+
+bool GisAttributeTable::hasSameSchema(const GisAttributeTable& other) const {
+    if (columns_.size() != other.columns_.size()) {
+        return false;
+    }
+
+    for (std::size_t column = 0; column < columns_.size(); ++column) {
+        if (columns_[column].name != other.columns_[column].name ||
+            columns_[column].type != other.columns_[column].type) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void GisAttributeTable::reserve(std::size_t rowsCount) {
+    for (auto& column : columns_) {
+        if (column.loader) {
+            continue;
+        }
+
+        switch (column.type) {
+            case FieldTypeInteger:
+            case FieldTypeDate:
+                column.integers.reserve(rowsCount);
+                break;
+            case FieldTypeDouble:
+                column.doubles.reserve(rowsCount);
+                break;
+            case FieldTypeString:
+                column.codes.reserve(rowsCount);
+                break;
+        }
+        column.nulls.reserve(rowsCount);
+    }
+}
+
+std::size_t GisAttributeTable::addRow() {
+    for (auto& column : columns_) {
+        // Lazy columns get values of all rows when they are loaded.
+        if (!column.loader) {
+            addValues(column, 1);
+        }
+    }
+
+    return rowsCount_++;
+}
+
+std::size_t GisAttributeTable::rowsCount() const { return rowsCount_; }
+
+void GisAttributeTable::setNull(std::size_t row, std::size_t column) {
+    loadColumn(column);
+    columns_[column].nulls[row] = true;
+}
+
+void GisAttributeTable::setInt(std::size_t row, std::size_t column, std::int64_t value) {
+    loadColumn(column);
+    Column& tableColumn = columns_[column];
+
+    switch (tableColumn.type) {
+        case FieldTypeInteger:
+        case FieldTypeDate:
+            tableColumn.integers[row] = value;
+            break;
+        case FieldTypeDouble:
+            tableColumn.doubles[row] = static_cast<double>(value);
+            break;
+        case FieldTypeString:
+            tableColumn.codes[row] = dictionaryCode(tableColumn, std::to_string(value));
+            break;
+    }
+    tableColumn.nulls[row] = false;
+}
+
+void GisAttributeTable::setDouble(std::size_t row, std::size_t column, double value) {
+    loadColumn(column);
+    Column& tableColumn = columns_[column];
+
+    switch (tableColumn.type) {
+        case FieldTypeInteger:
+        case FieldTypeDate:
+            tableColumn.integers[row] = static_cast<std::int64_t>(value);
+            break;
+        case FieldTypeDouble:
+            tableColumn.doubles[row] = value;
+            break;
+        case FieldTypeString: {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+            tableColumn.codes[row] = dictionaryCode(tableColumn, buffer);
+            break;
+        }
+    }
+    tableColumn.nulls[row] = false;
+}
+
+void GisAttributeTable::setString(std::size_t row, std::size_t column, std::string_view value) {
+    loadColumn(column);
+    Column& tableColumn = columns_[column];
+
+    if (tableColumn.type == FieldTypeString) {
+        tableColumn.codes[row] = dictionaryCode(tableColumn, value);
+        tableColumn.nulls[row] = false;
+        return;
+    }
+
+    // Numbers are parsed from a null-terminated copy, empty values stay null.
+    std::string text(value);
+    char* end = nullptr;
+
+    if (tableColumn.type == FieldTypeDouble) {
+        double number = std::strtod(text.c_str(), &end);
+        if (end != text.c_str()) {
+            setDouble(row, column, number);
+        }
+    } else {
+        long long number = std::strtoll(text.c_str(), &end, 10);
+        if (end != text.c_str()) {
+            setInt(row, column, number);
+        }
+    }
+}
+
+void GisAttributeTable::setDate(std::size_t row, std::size_t column, int year, int month,
+                                int day) {
+    setInt(row, column, static_cast<std::int64_t>(year) * 10000 + month * 100 + day);
+}
+
+bool GisAttributeTable::isNull(std::size_t row, std::size_t column) const {
+    loadColumn(column);
+    return columns_[column].nulls[row];
+}
+
+std::int64_t GisAttributeTable::valueAsInt(std::size_t row, std::size_t column) const {
+    loadColumn(column);
+    const Column& tableColumn = columns_[column];
+
+    if (tableColumn.nulls[row]) {
+        return 0;
+    }
+
+    switch (tableColumn.type) {
+        case FieldTypeInteger:
+        case FieldTypeDate:
+            return tableColumn.integers[row];
+        case FieldTypeDouble:
+            return static_cast<std::int64_t>(tableColumn.doubles[row]);
+        case FieldTypeString:
+            return std::strtoll(tableColumn.dictionary[tableColumn.codes[row]].c_str(), nullptr,
+                                10);
+    }
+
+    return 0;
+}
+
+double GisAttributeTable::valueAsDouble(std::size_t row, std::size_t column) const {
+    loadColumn(column);
+    const Column& tableColumn = columns_[column];
+
+    if (tableColumn.nulls[row]) {
+        return 0.0;
+    }
+
+    switch (tableColumn.type) {
+        case FieldTypeInteger:
+        case FieldTypeDate:
+            return static_cast<double>(tableColumn.integers[row]);
+        case FieldTypeDouble:
+            return tableColumn.doubles[row];
+        case FieldTypeString:
+            return std::strtod(tableColumn.dictionary[tableColumn.codes[row]].c_str(), nullptr);
+    }
+
+    return 0.0;
+}
+
+std::string GisAttributeTable::valueAsString(std::size_t row, std::size_t column) const {
+    loadColumn(column);
+    const Column& tableColumn = columns_[column];
+
+    if (tableColumn.nulls[row]) {
+        return std::string();
+    }
+
+    char buffer[64];
+
+    switch (tableColumn.type) {
+        case FieldTypeInteger:
+        case FieldTypeDate:
+            return std::to_string(tableColumn.integers[row]);
+        case FieldTypeDouble:
+            if (tableColumn.precision >= 0) {
+                std::snprintf(buffer, sizeof(buffer), "%.*f", tableColumn.precision,
+                              tableColumn.doubles[row]);
+            } else {
+                std::snprintf(buffer, sizeof(buffer), "%.15g", tableColumn.doubles[row]);
+            }
+            return buffer;
+        case FieldTypeString:
+            return tableColumn.dictionary[tableColumn.codes[row]];
+    }
+
+    return std::string();
+}
+
+std::size_t GisAttributeTable::append(const GisAttributeTable& other) {
+    std::size_t firstRow = rowsCount_;
+
+    for (std::size_t column = 0; column < columns_.size(); ++column) {
+        Column& tableColumn = columns_[column];
+        const Column& otherColumn = other.columns_[column];
+
+        // Rows of both tables are still deferred to their loaders.
+        if (tableColumn.loader && otherColumn.loader) {
+            continue;
+        }
+        loadColumn(column);
+        other.loadColumn(column);
+
+        tableColumn.integers.insert(tableColumn.integers.end(), otherColumn.integers.begin(),
+                                    otherColumn.integers.end());
+        tableColumn.doubles.insert(tableColumn.doubles.end(), otherColumn.doubles.begin(),
+                                   otherColumn.doubles.end());
+        tableColumn.nulls.insert(tableColumn.nulls.end(), otherColumn.nulls.begin(),
+                                 otherColumn.nulls.end());
+
+        // Codes of the other dictionary are translated to codes of this one.
+        std::vector<std::uint32_t> codes(otherColumn.dictionary.size());
+        for (std::size_t code = 0; code < codes.size(); ++code) {
+            codes[code] = dictionaryCode(tableColumn, otherColumn.dictionary[code]);
+        }
+        for (std::uint32_t code : otherColumn.codes) {
+            tableColumn.codes.push_back(codes.empty() ? 0 : codes[code]);
+        }
+    }
+
+    rowsCount_ += other.rowsCount_;
+
+    return firstRow;
+}
+
+std::size_t GisAttributeTable::memoryUsage() const {
+    std::size_t usage = 0;
+
+    for (const auto& column : columns_) {
+        usage += column.integers.capacity() * sizeof(std::int64_t) +
+                 column.doubles.capacity() * sizeof(double) +
+                 column.codes.capacity() * sizeof(std::uint32_t) + column.nulls.capacity() / 8;
+
+        for (const auto& value : column.dictionary) {
+            usage += sizeof(std::string) + (value.capacity() > 15 ? value.capacity() + 1 : 0);
+        }
+        // Node of the hash map holds the view, the code and the hash.
+        usage += column.dictionaryCodes.size() * (sizeof(std::string_view) + 4 * sizeof(void*)) +
+                 column.dictionaryCodes.bucket_count() * sizeof(void*);
+    }
+
+    return usage;
+}
+
+std::uint32_t GisAttributeTable::dictionaryCode(Column& column, std::string_view value) {
+    auto codeIter = column.dictionaryCodes.find(value);
+    if (codeIter != column.dictionaryCodes.end()) {
+        return codeIter->second;
+    }
+
+    auto code = static_cast<std::uint32_t>(column.dictionary.size());
+    column.dictionary.emplace_back(value);
+    column.dictionaryCodes.emplace(column.dictionary.back(), code);
+
+    return code;
+}
+
+void GisAttributeTable::addValues(Column& column, std::size_t count) {
+    switch (column.type) {
+        case FieldTypeInteger:
+        case FieldTypeDate:
+            column.integers.resize(column.integers.size() + count, 0);
+            break;
+        case FieldTypeDouble:
+            column.doubles.resize(column.doubles.size() + count, 0.0);
+            break;
+        case FieldTypeString:
+            column.codes.resize(column.codes.size() + count, 0);
+            break;
+    }
+    column.nulls.resize(column.nulls.size() + count, true);
+}
@@ -0,0 +1,213 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisAttributeTable.
+  */
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Columnar storage of the attributes of all entities of a layer.
+ * @details Schema (names and types of fields) is shared by all rows. Every
+ * column keeps its values in one contiguous array of its type, strings are
+ * dictionary encoded, so repeated values are stored once.\n
+ * Usage: describe schema with addColumn(), then call addRow() and setters for
+ * every entity.\n
+ * Columns added by addLazyColumn() stay empty until their first access, then
+ * the loader fills values of all rows at once. Loading is not synchronized,
+ * call loadColumns() before reading the table from several threads.
+ */
+class GisAttributeTable {
+   public:
+    /**
+     * @brief Type of values of a column.
+     */
+    enum FieldType {
+        FieldTypeInteger,  ///< 64-bit signed integer.
+        FieldTypeDouble,   ///< Double precision floating point number.
+        FieldTypeString,   ///< Dictionary encoded string.
+        FieldTypeDate      ///< Date stored as YYYYMMDD integer.
+    };
+
+    /**
+     * @brief Function that fills values of all rows of the column with setters
+     * of the table.
+     */
+    using ColumnLoader = std::function<void(GisAttributeTable& table, std::size_t column)>;
+
+    GisAttributeTable();
+
+    GisAttributeTable(const GisAttributeTable&) = delete;
+    GisAttributeTable& operator=(const GisAttributeTable&) = delete;
+    GisAttributeTable(GisAttributeTable&&) = default;
+    GisAttributeTable& operator=(GisAttributeTable&&) = default;
+
+    /**
+     * @brief Remove all columns and rows.
+     */
+    void clear();
+
+    /**
+     * @brief Remove all rows keeping the schema.
+     */
+    void clearRows();
+
+    /**
+     * @brief Add column to the schema, must be called before addRow().
+     * @param name - name of the field.
+     * @param type - type of values.
+     * @param precision - number of digits after decimal point used to print
+     * double values, -1 prints the shortest exact representation.
+     * @return Index of the column.
+     */
+    std::size_t addColumn(const std::string& name, FieldType type, int precision = -1);
+
+    /**
+     * @brief Add column whose values are filled by loader on first access.
+     * @details Rows added before the access are null in the column until the
+     * loader sets them.
+     * @param name - name of the field.
+     * @param type - type of values.
+     * @param precision - number of digits after decimal point used to print
+     * double values, -1 prints the shortest exact representation.
+     * @param loader - function that fills the column.
+     * @return Index of the column.
+     */
+    std::size_t addLazyColumn(const std::string& name, FieldType type, int precision,
+                              ColumnLoader loader);
+
+    /**
+     * @brief Check whether values of the column are in memory.
+     * @return False - for lazy columns that weren't accessed yet. True - otherwise.
+     */
+    bool isColumnLoaded(std::size_t column) const;
+
+    /**
+     * @brief Fill lazy column by its loader if it wasn't loaded yet.
+     * @param column - index of the column.
+     */
+    void loadColumn(std::size_t column) const;
+
+    /**
+     * @brief Fill all lazy columns that weren't loaded yet.
+     */
+    void loadColumns() const;
+
+    std::size_t columnsCount() const;
+    const std::string& columnName(std::size_t column) const;
+    FieldType columnType(std::size_t column) const;
+    int columnPrecision(std::size_t column) const;
+
+    /**
+     * @brief Find column by name of the field.
+     * @param name - name of the field.
+     * @return Index of the column, -1 if there is no such field.
+     */
+    int columnIndex(const std::string& name) const;
+
+    /**
+     * @brief Check whether both tables have the same columns.
+     * @param other - table to compare schema with.
+     * @return True - if names and types of all columns are equal. False - otherwise.
+     */
+    bool hasSameSchema(const GisAttributeTable& other) const;
+
+    /**
+     * @brief Preallocate memory for given number of rows.
+     * @param rowsCount - expected number of rows.
+     */
+    void reserve(std::size_t rowsCount);
+
+    /**
+     * @brief Append row with null values in all columns.
+     * @return Index of the new row.
+     */
+    std::size_t addRow();
+
+    std::size_t rowsCount() const;
+
+    /**
+     * @brief Set value of the cell, value is converted to type of the column.
+     * @param row - index of the row.
+     * @param column - index of the column.
+     * @param value - value to set.
+     */
+    void setNull(std::size_t row, std::size_t column);
+    void setInt(std::size_t row, std::size_t column, std::int64_t value);
+    void setDouble(std::size_t row, std::size_t column, double value);
+    void setString(std::size_t row, std::size_t column, std::string_view value);
+    void setDate(std::size_t row, std::size_t column, int year, int month, int day);
+
+    bool isNull(std::size_t row, std::size_t column) const;
+
+    /**
+     * @brief Get value of the cell as integer.
+     * @details Numeric and date columns are read in O(1), strings are parsed.
+     * @return Value of the cell, 0 for null values.
+     */
+    std::int64_t valueAsInt(std::size_t row, std::size_t column) const;
+
+    /**
+     * @brief Get value of the cell as double.
+     * @details Numeric and date columns are read in O(1), strings are parsed.
+     * @return Value of the cell, 0 for null values.
+     */
+    double valueAsDouble(std::size_t row, std::size_t column) const;
+
+    /**
+     * @brief Get value of the cell as string.
+     * @return Value of the cell, empty string for null values.
+     */
+    std::string valueAsString(std::size_t row, std::size_t column) const;
+
+    /**
+     * @brief Append all rows of other table with the same schema after rows of
+     * this one.
+     * @param other - table to copy rows from.
+     * @return Index of the first appended row.
+     */
+    std::size_t append(const GisAttributeTable& other);
+
+    /**
+     * @brief Get number of bytes occupied by the table.
+     * @return Approximate size of allocated arrays and dictionaries in bytes.
+     */
+    std::size_t memoryUsage() const;
+
+   private:
+    struct Column {
+        Column(const std::string& name, FieldType type, int precision, ColumnLoader loader);
+
+        // Views of dictionaryCodes point to strings of dictionary, copies would
+        // point to the original ones.
+        Column(const Column&) = delete;
+        Column& operator=(const Column&) = delete;
+        Column(Column&&) = default;
+        Column& operator=(Column&&) = default;
+
+        std::string name;
+        FieldType type;
+        int precision;
+        std::vector<std::int64_t> integers;  // values of integer and date columns
+        std::vector<double> doubles;         // values of double columns
+        std::vector<std::uint32_t> codes;    // dictionary codes of string columns
+        std::vector<bool> nulls;
+        std::deque<std::string> dictionary;  // deque keeps strings in place for the views
+        std::unordered_map<std::string_view, std::uint32_t> dictionaryCodes;
+        ColumnLoader loader;  // set until values of a lazy column are loaded
+    };
+
+    std::uint32_t dictionaryCode(Column& column, std::string_view value);
+    void addValues(Column& column, std::size_t count);
+
+    std::vector<Column> columns_;
+    std::size_t rowsCount_;
+};
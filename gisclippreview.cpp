@@ -0,0 +1,210 @@
+#include "gisclippreview.h"
+
+#include "gisrectangleclipper.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// Entities processed between checks whether the job is canceled.
+const std::size_t cancelCheckPeriod = 1024;
+
+/**
+ * @brief Check whether clipping by both rectangles gives the same result.
+ * @details It does if the entity is outside of both, or if every side either
+ * stays in place or lies beyond the envelope both before and after.
+ */
+bool isClipUnchanged(const GisEnvelope &envelope, const GisEnvelope &before,
+                     const GisEnvelope &after) {
+    if (!before.intersects(envelope) && !after.intersects(envelope)) {
+        return true;
+    }
+
+    return (before.minX() == after.minX() ||
+            (before.minX() < envelope.minX() && after.minX() < envelope.minX())) &&
+           (before.minY() == after.minY() ||
+            (before.minY() < envelope.minY() && after.minY() < envelope.minY())) &&
+           (before.maxX() == after.maxX() ||
+            (before.maxX() > envelope.maxX() && after.maxX() > envelope.maxX())) &&
+           (before.maxY() == after.maxY() ||
+            (before.maxY() > envelope.maxY() && after.maxY() > envelope.maxY()));
+}
+
+/**
+ * @brief Find entities that a side may change clipping of when the rectangle
+ * changes.
+ * @details Every side that moved sweeps a strip across both rectangles,
+ * entities whose envelopes miss all the strips keep their clipping.
+ * @param candidates - indices of entities are appended to it, some more than once.
+ */
+void findCandidates(const GisRTree &tree, const GisEnvelope &before, const GisEnvelope &after,
+                    std::vector<std::size_t> &candidates) {
+    double minX = std::min(before.minX(), after.minX());
+    double minY = std::min(before.minY(), after.minY());
+    double maxX = std::max(before.maxX(), after.maxX());
+    double maxY = std::max(before.maxY(), after.maxY());
+
+    if (before.minX() != after.minX()) {
+        tree.query(GisEnvelope(minX, minY, std::max(before.minX(), after.minX()), maxY),
+                   candidates);
+    }
+    if (before.maxX() != after.maxX()) {
+        tree.query(GisEnvelope(std::min(before.maxX(), after.maxX()), minY, maxX, maxY),
+                   candidates);
+    }
+    if (before.minY() != after.minY()) {
+        tree.query(GisEnvelope(minX, minY, maxX, std::max(before.minY(), after.minY())),
+                   candidates);
+    }
+    if (before.maxY() != after.maxY()) {
+        tree.query(GisEnvelope(minX, std::min(before.maxY(), after.maxY()), maxX, maxY),
+                   candidates);
+    }
+}
+
+} // namespace
+
+GisClipPreview::GisClipPreview(const std::vector<GisEntity> &entities, const GisRTree &tree,
+                               ResultReady resultReady)
+    : entities_(entities),
+      tree_(tree),
+      resultReady_(std::move(resultReady)),
+      hasRequest_(false),
+      hasResult_(false),
+      stop_(false),
+      generation_(0),
+      rectangle_(std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(),
+                 std::numeric_limits<double>::max(), std::numeric_limits<double>::max()),
+      kinds_(entities.size(), KindInside),
+      candidateJobs_(entities.size(), 0),
+      jobsCount_(0),
+      thread_(&GisClipPreview::run, this) {}
+
+GisClipPreview::~GisClipPreview() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        ++generation_;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void GisClipPreview::requestClip(const GisEnvelope &rectangle) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        requestedRectangle_ = rectangle;
+        hasRequest_ = true;
+        ++generation_;
+    }
+    condition_.notify_one();
+}
+
+bool GisClipPreview::takeResult(Result &result) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!hasResult_) {
+            return false;
+        }
+        result = std::move(result_);
+        result_ = Result();
+        hasResult_ = false;
+    }
+    condition_.notify_one();
+
+    return true;
+}
+
+void GisClipPreview::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+        condition_.wait(lock, [this] { return stop_ || (hasRequest_ && !hasResult_); });
+        if (stop_) {
+            return;
+        }
+
+        GisEnvelope rectangle = requestedRectangle_;
+        unsigned generation = generation_;
+        hasRequest_ = false;
+        lock.unlock();
+
+        Result result;
+        bool isFinished = clip(rectangle, generation, result);
+
+        lock.lock();
+        if (isFinished) {
+            result_ = std::move(result);
+            hasResult_ = true;
+
+            if (resultReady_) {
+                lock.unlock();
+                resultReady_();
+                lock.lock();
+            }
+        }
+    }
+}
+
+bool GisClipPreview::clip(const GisEnvelope &rectangle, unsigned generation, Result &result) {
+    GisRectangleClipper clipper(rectangle);
+    auto clipped = std::make_shared<GisGeometryStore>();
+
+    // Entities found by several strips are marked by the job on the first visit.
+    if (++jobsCount_ == 0) {
+        std::fill(candidateJobs_.begin(), candidateJobs_.end(), 0);
+        jobsCount_ = 1;
+    }
+    std::vector<std::size_t> candidates;
+    findCandidates(tree_, rectangle_, rectangle, candidates);
+
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        if (i % cancelCheckPeriod == 0 && generation_ != generation) {
+            return false;
+        }
+
+        std::size_t entityIndex = candidates[i];
+        if (candidateJobs_[entityIndex] == jobsCount_) {
+            continue;
+        }
+        candidateJobs_[entityIndex] = jobsCount_;
+
+        const GisEntity &entity = entities_[entityIndex];
+        GisEnvelope envelope = entity.envelope();
+
+        // Strips are wider than needed, some candidates keep their clipping.
+        if (isClipUnchanged(envelope, rectangle_, rectangle)) {
+            continue;
+        }
+
+        Kind kind = KindOutside;
+        std::size_t geometryIndex = 0;
+        if (rectangle.contains(envelope)) {
+            kind = KindInside;
+        } else if (rectangle.intersects(envelope) &&
+                   clipper.clipPolygon(entity, *clipped, geometryIndex)) {
+            kind = KindClipped;
+        }
+
+        if (kind != kinds_[entityIndex] || kind == KindClipped) {
+            result.entities.push_back(entityIndex);
+            result.kinds.push_back(kind);
+            result.geometryIndices.push_back(geometryIndex);
+        }
+    }
+
+    // The job is finished, it becomes the base of the next one. Clipped
+    // geometry of unchanged entities was taken by earlier results, so the
+    // store holds only entities clipped by this job.
+    for (std::size_t i = 0; i < result.entities.size(); ++i) {
+        kinds_[result.entities[i]] = result.kinds[i];
+    }
+    rectangle_ = rectangle;
+
+    result.rectangle = rectangle;
+    result.geometry = clipped;
+
+    return true;
+}
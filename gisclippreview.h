@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisClipPreview.
+  */
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gisentity.h"
+#include "gisenvelope.h"
+#include "gisgeometrystore.h"
+#include "gisrtree.h"
+
+/**
+ * @brief Clipping of entities by a rectangle in a background thread for
+ * previews while the rectangle changes.
+ * @details Every result tells only which entities changed since the previous
+ * one. An entity is clipped again only if a side of the rectangle that moved
+ * crosses its envelope before or after the move. Such entities are found by
+ * the R-tree in strips swept by the moved sides, so a job costs as many
+ * entities as there are in the strips, whatever size the layer is. Results
+ * carry geometry only of entities clipped again, the preview doesn't keep it
+ * after that. A new request cancels the job in progress. Entities are clipped
+ * by GisRectangleClipper, the same way as GisFileReader::clipPolygons() with
+ * GisFileReader::ClipMethodRectangle does. Entities and the tree must not
+ * change while the preview exists.
+ */
+class GisClipPreview {
+   public:
+    /**
+     * @brief State of an entity in the preview.
+     */
+    enum Kind : unsigned char {
+        KindInside,   ///< Entity is shown as it is.
+        KindOutside,  ///< Entity is hidden.
+        KindClipped   ///< Entity is shown clipped.
+    };
+
+    /**
+     * @brief Changes of the preview since the previous result.
+     */
+    struct Result {
+        GisEnvelope rectangle;
+        std::vector<std::size_t> entities;         // indices of changed entities
+        std::vector<Kind> kinds;                   // new states of changed entities
+        std::vector<std::size_t> geometryIndices;  // clipped entities inside of geometry
+        std::shared_ptr<const GisGeometryStore> geometry;  // entities clipped by the job
+    };
+
+    /**
+     * @brief Function called in the background thread when a result is ready
+     * to be taken by takeResult().
+     */
+    using ResultReady = std::function<void()>;
+
+    /**
+     * @brief Start the background thread, all entities are inside at first.
+     * @param entities - entities to clip, they are referenced and not copied.
+     * @param tree - tree over envelopes of the entities, referenced too.
+     * @param resultReady - function to notify about new results, may be empty.
+     */
+    GisClipPreview(const std::vector<GisEntity>& entities, const GisRTree& tree,
+                   ResultReady resultReady);
+
+    /**
+     * @brief Cancel the job in progress and stop the background thread.
+     */
+    ~GisClipPreview();
+
+    GisClipPreview(const GisClipPreview&) = delete;
+    GisClipPreview& operator=(const GisClipPreview&) = delete;
+
+    /**
+     * @brief Request clipping by the rectangle instead of any previous request.
+     */
+    void requestClip(const GisEnvelope& rectangle);
+
+    /**
+     * @brief Take the next result, the next job doesn't start until it is taken.
+     * @param result - changes to apply on top of the previous result.
+     * @return True - if a result was ready. False - otherwise.
+     */
+    bool takeResult(Result& result);
+
+   private:
+    void run();
+
+    /**
+     * @brief Clip entities affected by the change of the rectangle.
+     * @param generation - generation of the request, the job is canceled when
+     * generation_ changes.
+     * @return True - if the job finished. False - if it was canceled.
+     */
+    bool clip(const GisEnvelope& rectangle, unsigned generation, Result& result);
+
+    const std::vector<GisEntity>& entities_;
+    const GisRTree& tree_;
+    ResultReady resultReady_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    GisEnvelope requestedRectangle_;
+    bool hasRequest_;
+    bool hasResult_;
+    bool stop_;
+    Result result_;
+    std::atomic<unsigned> generation_;
+
+    // Preview of the last finished job, used only by the background thread.
+    GisEnvelope rectangle_;
+    std::vector<Kind> kinds_;
+    std::vector<unsigned> candidateJobs_;  // last job that found every entity in the strips
+    unsigned jobsCount_;
+
+    std::thread thread_;
+};
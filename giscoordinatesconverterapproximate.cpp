@@ -0,0 +1,409 @@
+#include "giscoordinatesconverterapproximate.h"
+
+#include "gissimd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Tiles are refined twice per step, error of cubic interpolation drops 16
+// times per step. 64x64 tiles take 1 MB per grid.
+const int initialTilesCount = 4;
+const int maxTilesCount = 64;
+
+// Monomial coefficients of cubic through values in nodes 0, 1, 2 and 3:
+// coefficient of u^i is sum of lagrangeCoeff[i][k] * value[k].
+const double lagrangeCoeff[4][4] = {{1.0, 0.0, 0.0, 0.0},
+                                    {-11.0 / 6, 3.0, -1.5, 1.0 / 3},
+                                    {1.0, -2.5, 2.0, -0.5},
+                                    {-1.0 / 6, 0.5, -0.5, 1.0 / 6}};
+
+// Extents narrower than that (e.g. layer of one point) are widened to it.
+const double minGridSize = 1e-9;
+
+// Points on the far sides may get a bit beyond the last tile due to rounding.
+const double edgeSlack = 1e-9;
+
+// Points per side of the extent whose conversion bounds the backward grid.
+const int extentSidePoints = 1024;
+
+// Sample positions in tile coordinates: 1.5 and 1.5 +- sqrt(5) / 2, where error
+// of cubic interpolation through nodes 0, 1, 2 and 3 peaks, and the nodes for
+// the other coordinate to sample sides of tiles.
+const double sampleOffsets[6] = {0.0, 1.5 - 1.11803398874989485, 1.0, 1.5, 2.0,
+                                 1.5 + 1.11803398874989485};
+
+/**
+ * @brief Evaluate cubic polynomials of two variables.
+ * @param coeff - 32 coefficients of the tile, see Grid.
+ */
+inline void polynomials(const double *coeff, double u, double v, double &x, double &y) {
+    // Polynomials of u for every power of v, for X in the first 4 and for Y in the rest.
+    double rows[8];
+    for (int j = 0; j < 8; ++j) {
+        rows[j] = ((coeff[24 + j] * u + coeff[16 + j]) * u + coeff[8 + j]) * u + coeff[j];
+    }
+
+    x = rows[0] + v * (rows[1] + v * (rows[2] + v * rows[3]));
+    y = rows[4] + v * (rows[5] + v * (rows[6] + v * rows[7]));
+}
+
+/**
+ * @brief Fit cubic polynomial of two variables to values in 4x4 nodes.
+ * @param values - values in nodes, values[l][k] is at u = k, v = l.
+ * @param coeff - coefficients of u^i * v^j are written at [8 * i + j].
+ */
+void fitPolynomial(const double values[4][4], double *coeff) {
+    // Along u in every row of nodes, then along v.
+    double rows[4][4];
+    for (int l = 0; l < 4; ++l) {
+        for (int i = 0; i < 4; ++i) {
+            rows[l][i] = 0;
+            for (int k = 0; k < 4; ++k) {
+                rows[l][i] += lagrangeCoeff[i][k] * values[l][k];
+            }
+        }
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            coeff[8 * i + j] = 0;
+            for (int l = 0; l < 4; ++l) {
+                coeff[8 * i + j] += lagrangeCoeff[j][l] * rows[l][i];
+            }
+        }
+    }
+}
+
+} // namespace
+
+GisCoordinatesConverterApproximate::GisCoordinatesConverterApproximate(double mapCenterLongitude,
+                                                                       double mapCenterLatitude)
+    : exact_(mapCenterLongitude, mapCenterLatitude),
+      grid_(),
+      gridBack_(),
+      approximate_(false),
+      maxError_(0),
+      maxErrorBack_(0) {}
+
+GisCoordinatesConverterApproximate::~GisCoordinatesConverterApproximate() = default;
+
+bool GisCoordinatesConverterApproximate::fit(double minLongitude, double minLatitude,
+                                             double maxLongitude, double maxLatitude,
+                                             double tolerance) {
+    approximate_ = false;
+    maxError_ = std::numeric_limits<double>::infinity();
+    maxErrorBack_ = std::numeric_limits<double>::infinity();
+
+    if (!(minLongitude <= maxLongitude && minLatitude <= maxLatitude)) {
+        return false;
+    }
+
+    for (int tilesCount = initialTilesCount; tilesCount <= maxTilesCount; tilesCount *= 2) {
+        fillGrid(grid_, minLongitude, minLatitude, maxLongitude, maxLatitude, tilesCount, false);
+        maxError_ = gridError(grid_, false);
+        if (maxError_ <= tolerance) {
+            break;
+        }
+    }
+    if (!(maxError_ <= tolerance)) {
+        return false;
+    }
+
+    // Backward grid covers conversion of the extent sides.
+    std::vector<double> x(4 * extentSidePoints);
+    std::vector<double> y(4 * extentSidePoints);
+    for (int i = 0; i < extentSidePoints; ++i) {
+        double longitude = minLongitude + (maxLongitude - minLongitude) * i / extentSidePoints;
+        double latitude = minLatitude + (maxLatitude - minLatitude) * i / extentSidePoints;
+        x[4 * i] = longitude;
+        y[4 * i] = minLatitude;
+        x[4 * i + 1] = maxLongitude + minLongitude - longitude;
+        y[4 * i + 1] = maxLatitude;
+        x[4 * i + 2] = minLongitude;
+        y[4 * i + 2] = maxLatitude + minLatitude - latitude;
+        x[4 * i + 3] = maxLongitude;
+        y[4 * i + 3] = latitude;
+    }
+    exact_.transformCoordinates(x.data(), y.data(), x.data(), y.data(), x.size());
+
+    auto xBounds = std::minmax_element(x.begin(), x.end());
+    auto yBounds = std::minmax_element(y.begin(), y.end());
+
+    for (int tilesCount = initialTilesCount; tilesCount <= maxTilesCount; tilesCount *= 2) {
+        fillGrid(gridBack_, *xBounds.first, *yBounds.first, *xBounds.second, *yBounds.second,
+                 tilesCount, true);
+        maxErrorBack_ = gridError(gridBack_, true);
+        if (maxErrorBack_ <= tolerance) {
+            break;
+        }
+    }
+
+    approximate_ = maxErrorBack_ <= tolerance;
+
+    return approximate_;
+}
+
+bool GisCoordinatesConverterApproximate::isApproximate() const { return approximate_; }
+
+double GisCoordinatesConverterApproximate::maxError() const { return maxError_; }
+
+double GisCoordinatesConverterApproximate::maxErrorBack() const { return maxErrorBack_; }
+
+GAPoint GisCoordinatesConverterApproximate::transformCoordinate(const GAPoint &sourceCoordinate) {
+    double x;
+    double y;
+    if (approximate_ && interpolate(grid_, sourceCoordinate.x(), sourceCoordinate.y(), x, y)) {
+        return {x, y};
+    }
+
+    return exact_.transformCoordinate(sourceCoordinate);
+}
+
+GAPoint GisCoordinatesConverterApproximate::transformCoordinateBack(
+    const GAPoint &sourceCoordinate) {
+    double x;
+    double y;
+    if (approximate_ &&
+        interpolate(gridBack_, sourceCoordinate.x(), sourceCoordinate.y(), x, y)) {
+        return {x, y};
+    }
+
+    return exact_.transformCoordinateBack(sourceCoordinate);
+}
+
+void GisCoordinatesConverterApproximate::transformCoordinates(const double *x, const double *y,
+                                                              double *xOut, double *yOut,
+                                                              std::size_t count) {
+    if (!approximate_) {
+        exact_.transformCoordinates(x, y, xOut, yOut, count);
+        return;
+    }
+
+    // Points are interpolated on every processor, as by transformCoordinate().
+#ifdef GIS_AVX2_KERNEL
+    if (gisCpuSupportsAvx2()) {
+        interpolatePointsAvx2(grid_, false, x, y, xOut, yOut, count);
+        return;
+    }
+#endif
+
+    interpolatePoints(grid_, false, x, y, xOut, yOut, count);
+}
+
+void GisCoordinatesConverterApproximate::transformCoordinatesBack(const double *x,
+                                                                  const double *y, double *xOut,
+                                                                  double *yOut,
+                                                                  std::size_t count) {
+    if (!approximate_) {
+        exact_.transformCoordinatesBack(x, y, xOut, yOut, count);
+        return;
+    }
+
+#ifdef GIS_AVX2_KERNEL
+    if (gisCpuSupportsAvx2()) {
+        interpolatePointsAvx2(gridBack_, true, x, y, xOut, yOut, count);
+        return;
+    }
+#endif
+
+    interpolatePoints(gridBack_, true, x, y, xOut, yOut, count);
+}
+
+const double *GisCoordinatesConverterApproximate::tile(const Grid &grid, double x, double y,
+                                                       double &u, double &v) {
+    u = (x - grid.minX) * grid.tilesPerUnitX;
+    v = (y - grid.minY) * grid.tilesPerUnitY;
+
+    // Distance to the grid center in tiles, written so that NaN is outside too.
+    double halfSize = 0.5 * grid.tilesCount;
+    if (!(std::max(std::fabs(u - halfSize), std::fabs(v - halfSize)) <= halfSize + edgeSlack)) {
+        return nullptr;
+    }
+
+    // Truncation gets 0 for slightly negative coordinates too.
+    int column = std::min(static_cast<int>(u), grid.tilesCount - 1);
+    int row = std::min(static_cast<int>(v), grid.tilesCount - 1);
+    u = 3 * (u - column);
+    v = 3 * (v - row);
+
+    return &grid.coefficients[32 * (static_cast<std::size_t>(row) * grid.tilesCount + column)];
+}
+
+bool GisCoordinatesConverterApproximate::interpolate(const Grid &grid, double x, double y,
+                                                     double &xOut, double &yOut) {
+    double u;
+    double v;
+    const double *coeff = tile(grid, x, y, u, v);
+    if (!coeff) {
+        return false;
+    }
+
+    polynomials(coeff, u, v, xOut, yOut);
+
+    return true;
+}
+
+void GisCoordinatesConverterApproximate::interpolatePoints(const Grid &grid, bool back,
+                                                           const double *x, const double *y,
+                                                           double *xOut, double *yOut,
+                                                           std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        double sourceX = x[i];
+        double sourceY = y[i];
+        if (!interpolate(grid, sourceX, sourceY, xOut[i], yOut[i])) {
+            transformExactly(back, sourceX, sourceY, xOut[i], yOut[i]);
+        }
+    }
+}
+
+#ifdef GIS_AVX2_KERNEL
+
+GIS_TARGET_AVX2 void GisCoordinatesConverterApproximate::interpolatePointsAvx2(
+    const Grid &grid, bool back, const double *x, const double *y, double *xOut, double *yOut,
+    std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        double sourceX = x[i];
+        double sourceY = y[i];
+        double u;
+        double v;
+        const double *coeff = tile(grid, sourceX, sourceY, u, v);
+        if (!coeff) {
+            transformExactly(back, sourceX, sourceY, xOut[i], yOut[i]);
+            continue;
+        }
+
+        // Lanes hold polynomials of u for powers of v from 0 to 3.
+        __m256d u4 = _mm256_set1_pd(u);
+        __m256d xRows = _mm256_loadu_pd(coeff + 24);
+        __m256d yRows = _mm256_loadu_pd(coeff + 28);
+        xRows = _mm256_fmadd_pd(xRows, u4, _mm256_loadu_pd(coeff + 16));
+        yRows = _mm256_fmadd_pd(yRows, u4, _mm256_loadu_pd(coeff + 20));
+        xRows = _mm256_fmadd_pd(xRows, u4, _mm256_loadu_pd(coeff + 8));
+        yRows = _mm256_fmadd_pd(yRows, u4, _mm256_loadu_pd(coeff + 12));
+        xRows = _mm256_fmadd_pd(xRows, u4, _mm256_loadu_pd(coeff));
+        yRows = _mm256_fmadd_pd(yRows, u4, _mm256_loadu_pd(coeff + 4));
+
+        double v2 = v * v;
+        __m256d powers = _mm256_set_pd(v2 * v, v2, v, 1.0);
+        __m256d sums = _mm256_hadd_pd(_mm256_mul_pd(xRows, powers), _mm256_mul_pd(yRows, powers));
+        __m128d result = _mm_add_pd(_mm256_castpd256_pd128(sums), _mm256_extractf128_pd(sums, 1));
+
+        _mm_store_sd(xOut + i, result);
+        _mm_storeh_pd(yOut + i, result);
+    }
+}
+
+#endif
+
+void GisCoordinatesConverterApproximate::transformExactly(bool back, double x, double y,
+                                                          double &xOut, double &yOut) {
+    GAPoint point = back ? exact_.transformCoordinateBack({x, y})
+                         : exact_.transformCoordinate({x, y});
+    xOut = point.x();
+    yOut = point.y();
+}
+
+void GisCoordinatesConverterApproximate::fillGrid(Grid &grid, double minX, double minY,
+                                                  double maxX, double maxY, int tilesCount,
+                                                  bool back) {
+    double sizeX = std::max(maxX - minX, minGridSize);
+    double sizeY = std::max(maxY - minY, minGridSize);
+    int stepsCount = 3 * tilesCount;
+
+    grid.minX = minX;
+    grid.minY = minY;
+    grid.tilesPerUnitX = tilesCount / sizeX;
+    grid.tilesPerUnitY = tilesCount / sizeY;
+    grid.tilesCount = tilesCount;
+    grid.coefficients.resize(32 * static_cast<std::size_t>(tilesCount) * tilesCount);
+
+    // Tiles share nodes on their sides, so polynomials of neighbours agree there.
+    std::size_t nodesCount = static_cast<std::size_t>(stepsCount) + 1;
+    std::vector<double> x(nodesCount * nodesCount);
+    std::vector<double> y(nodesCount * nodesCount);
+
+    for (std::size_t row = 0; row < nodesCount; ++row) {
+        for (std::size_t column = 0; column < nodesCount; ++column) {
+            x[row * nodesCount + column] = minX + sizeX * column / stepsCount;
+            y[row * nodesCount + column] = minY + sizeY * row / stepsCount;
+        }
+    }
+
+    if (back) {
+        exact_.transformCoordinatesBack(x.data(), y.data(), x.data(), y.data(), x.size());
+    } else {
+        exact_.transformCoordinates(x.data(), y.data(), x.data(), y.data(), x.size());
+    }
+
+    double xValues[4][4];
+    double yValues[4][4];
+
+    for (int row = 0; row < tilesCount; ++row) {
+        for (int column = 0; column < tilesCount; ++column) {
+            for (int l = 0; l < 4; ++l) {
+                for (int k = 0; k < 4; ++k) {
+                    std::size_t node = (3 * row + l) * nodesCount + 3 * column + k;
+                    xValues[l][k] = x[node];
+                    yValues[l][k] = y[node];
+                }
+            }
+
+            double *coeff =
+                &grid.coefficients[32 * (static_cast<std::size_t>(row) * tilesCount + column)];
+            fitPolynomial(xValues, coeff);
+            fitPolynomial(yValues, coeff + 4);
+        }
+    }
+}
+
+double GisCoordinatesConverterApproximate::gridError(const Grid &grid, bool back) {
+    std::size_t samplesCount = 6 * static_cast<std::size_t>(grid.tilesCount) + 1;
+    std::vector<double> samples(samplesCount);
+    for (std::size_t sample = 0; sample < samplesCount; ++sample) {
+        samples[sample] = sample / 6 + sampleOffsets[sample % 6] / 3;
+    }
+
+    std::vector<double> x(samplesCount);
+    std::vector<double> y(samplesCount);
+    std::vector<double> xExact(samplesCount);
+    std::vector<double> yExact(samplesCount);
+    std::vector<double> xApproximate(samplesCount);
+    std::vector<double> yApproximate(samplesCount);
+
+    double maxError = 0;
+
+    for (std::size_t row = 0; row < samplesCount; ++row) {
+        for (std::size_t column = 0; column < samplesCount; ++column) {
+            x[column] = grid.minX + samples[column] / grid.tilesPerUnitX;
+            y[column] = grid.minY + samples[row] / grid.tilesPerUnitY;
+            interpolate(grid, x[column], y[column], xApproximate[column], yApproximate[column]);
+        }
+
+        if (back) {
+            // Error in degrees is measured as distance between both results on the map.
+            exact_.transformCoordinatesBack(x.data(), y.data(), xExact.data(), yExact.data(),
+                                            samplesCount);
+            exact_.transformCoordinates(xExact.data(), yExact.data(), xExact.data(),
+                                        yExact.data(), samplesCount);
+            exact_.transformCoordinates(xApproximate.data(), yApproximate.data(),
+                                        xApproximate.data(), yApproximate.data(), samplesCount);
+        } else {
+            exact_.transformCoordinates(x.data(), y.data(), xExact.data(), yExact.data(),
+                                        samplesCount);
+        }
+
+        for (std::size_t column = 0; column < samplesCount; ++column) {
+            double error = std::hypot(xApproximate[column] - xExact[column],
+                                      yApproximate[column] - yExact[column]);
+            // NaN error (e.g. extent beyond the poles) never meets the tolerance.
+            if (!(error <= maxError)) {
+                maxError = error;
+            }
+        }
+    }
+
+    return maxError;
+}
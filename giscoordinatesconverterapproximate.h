@@ -0,0 +1,139 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisCoordinatesConverterApproximate.
+  */
+
+#include <vector>
+
+#include "giscoordinatesconvertersimple.h"
+
+/**
+ * @brief Converter that interpolates GisCoordinatesConverterSimple over grids
+ * precomputed for the extent of a layer.
+ * @details fit() splits the extent in degrees into square tiles, and the
+ * converted extent into tiles for the backward conversion, each with a cubic
+ * polynomial of both coordinates through 4x4 nodes of the exact conversion.
+ * Tiles are refined until their error is within tolerance. A point then costs
+ * one polynomial evaluation instead of the geocentric transform. Points outside
+ * of the grids, and all points if fit() failed, are converted exactly.
+ */
+class GisCoordinatesConverterApproximate : public GisCoordinatesConverterInterface {
+   public:
+    GisCoordinatesConverterApproximate(double mapCenterLongitude, double mapCenterLatitude);
+    virtual ~GisCoordinatesConverterApproximate();
+
+    /**
+     * @brief Build grids for the extent and check their error against the
+     * exact conversion.
+     * @details Error is measured halfway between all nodes, where
+     * interpolation deviates the most.
+     * @param minLongitude - minimal longitude of the extent in degrees.
+     * @param minLatitude - minimal latitude of the extent in degrees.
+     * @param maxLongitude - maximal longitude of the extent in degrees.
+     * @param maxLatitude - maximal latitude of the extent in degrees.
+     * @param tolerance - maximal allowed error in meters on the map.
+     * @return True - if both grids meet the tolerance and are used from now
+     * on. False - otherwise, conversion stays exact.
+     */
+    bool fit(double minLongitude, double minLatitude, double maxLongitude, double maxLatitude,
+             double tolerance);
+
+    /**
+     * @brief Check whether points inside of the extent are interpolated.
+     * @return True - if the last fit() succeeded. False - otherwise.
+     */
+    bool isApproximate() const;
+
+    /**
+     * @brief Get measured error of the grid of transformCoordinate().
+     * @return Maximal distance to the exact result in meters.
+     */
+    double maxError() const;
+
+    /**
+     * @brief Get measured error of the grid of transformCoordinateBack().
+     * @return Maximal distance to the exact result in meters on the map.
+     */
+    double maxErrorBack() const;
+
+    virtual GAPoint transformCoordinate(const GAPoint& sourceCoordinate);
+    virtual GAPoint transformCoordinateBack(const GAPoint& sourceCoordinate);
+
+    virtual void transformCoordinates(const double* x, const double* y, double* xOut,
+                                      double* yOut, std::size_t count);
+    virtual void transformCoordinatesBack(const double* x, const double* y, double* xOut,
+                                          double* yOut, std::size_t count);
+
+   private:
+    /**
+     * @brief Polynomials of a conversion in tiles of a regular grid.
+     * @details Tile coordinates u and v run from 0 to 3 between its nodes.
+     * Every tile has 32 coefficients, of u^i * v^j at [8 * i + j] for X and
+     * at [8 * i + 4 + j] for Y. Tiles go row by row from minY.
+     */
+    struct Grid {
+        double minX;
+        double minY;
+        double tilesPerUnitX;
+        double tilesPerUnitY;
+        int tilesCount;  // along every axis
+        std::vector<double> coefficients;
+    };
+
+    /**
+     * @brief Find tile of the grid with the point.
+     * @param u - tile coordinate of the point along X.
+     * @param v - tile coordinate of the point along Y.
+     * @return Coefficients of the tile or nullptr if the point is outside of the grid.
+     */
+    static const double* tile(const Grid& grid, double x, double y, double& u, double& v);
+
+    /**
+     * @brief Interpolate the grid in the point.
+     * @return True - if the point is inside of the grid. False - otherwise.
+     */
+    static bool interpolate(const Grid& grid, double x, double y, double& xOut, double& yOut);
+
+    /**
+     * @brief Interpolate the grid in points, points outside of it are
+     * converted exactly.
+     * @param back - true if the grid interpolates backward conversion.
+     */
+    void interpolatePoints(const Grid& grid, bool back, const double* x, const double* y,
+                           double* xOut, double* yOut, std::size_t count);
+
+    /**
+     * @brief interpolatePoints() evaluating polynomials with AVX2 instructions.
+     */
+    void interpolatePointsAvx2(const Grid& grid, bool back, const double* x, const double* y,
+                               double* xOut, double* yOut, std::size_t count);
+
+    /**
+     * @brief Convert the point exactly.
+     * @param back - true for backward conversion.
+     */
+    void transformExactly(bool back, double x, double y, double& xOut, double& yOut);
+
+    /**
+     * @brief Fit polynomials of tiles to conversion of their nodes.
+     * @param back - true to fit backward conversion.
+     */
+    void fillGrid(Grid& grid, double minX, double minY, double maxX, double maxY,
+                  int tilesCount, bool back);
+
+    /**
+     * @brief Measure error of the grid halfway between its nodes.
+     * @param back - true if the grid interpolates backward conversion.
+     * @return Maximal distance to the exact result in meters on the map.
+     */
+    double gridError(const Grid& grid, bool back);
+
+    GisCoordinatesConverterSimple exact_;
+    Grid grid_;
+    Grid gridBack_;
+    bool approximate_;
+    double maxError_;
+    double maxErrorBack_;
+};
@@ -1,10 +1,50 @@
 #pragma once
 
-class GAPoint;
+#include <cstddef>
+
+#include "gapoint.h"
 
 class GisCoordinatesConverterInterface {
    public:
     virtual ~GisCoordinatesConverterInterface() = default;
     virtual GAPoint transformCoordinate(const GAPoint& sourceCoordinate) = 0;
     virtual GAPoint transformCoordinateBack(const GAPoint& sourceCoordinate) = 0;
+
+    /**
+     * @brief Convert arrays of coordinates with transformCoordinate().
+     * @details Output arrays may be the input ones to convert in place.
+     * Default implementation converts points one by one, converters override
+     * it with faster bulk versions.
+     * @param x - source X coordinates.
+     * @param y - source Y coordinates.
+     * @param xOut - converted X coordinates.
+     * @param yOut - converted Y coordinates.
+     * @param count - number of points.
+     */
+    virtual void transformCoordinates(const double* x, const double* y, double* xOut,
+                                      double* yOut, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            GAPoint point = transformCoordinate({x[i], y[i]});
+            xOut[i] = point.x();
+            yOut[i] = point.y();
+        }
+    }
+
+    /**
+     * @brief Convert arrays of coordinates with transformCoordinateBack().
+     * @details Output arrays may be the input ones to convert in place.
+     * @param x - source X coordinates.
+     * @param y - source Y coordinates.
+     * @param xOut - converted X coordinates.
+     * @param yOut - converted Y coordinates.
+     * @param count - number of points.
+     */
+    virtual void transformCoordinatesBack(const double* x, const double* y, double* xOut,
+                                          double* yOut, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            GAPoint point = transformCoordinateBack({x[i], y[i]});
+            xOut[i] = point.x();
+            yOut[i] = point.y();
+        }
+    }
 };
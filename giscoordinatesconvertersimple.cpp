@@ -1,21 +1,242 @@
 #include "giscoordinatesconvertersimple.h"
 
-#include "coordconvert.h"
-
 #include "gapoint.h"
 #include "gautils.h"
+#include "gissimd.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Earth ellipsoid, the same as in coordconvert.cpp.
+const double earthRadius = 6378135.0;
+const double earthEccent2 = 0.0067394;
+
+const double degreesToRadians = M_PI / 180;
+
+// pi/2 split into 33 high bits and the rest, q * pio2High is exact for small q.
+const double twoOverPi = 6.36619772367581382433e-01;
+const double pio2High = 1.57079632673412561417e+00;
+const double pio2Low = 6.07710050650619224932e-11;
+
+// Minimax polynomials of sine and cosine on [-pi/4, pi/4] from fdlibm.
+const double sinCoeff1 = -1.66666666666666324348e-01;
+const double sinCoeff2 = 8.33333333332248946124e-03;
+const double sinCoeff3 = -1.98412698298579493134e-04;
+const double sinCoeff4 = 2.75573137070700676789e-06;
+const double sinCoeff5 = -2.50507602534068634195e-08;
+const double sinCoeff6 = 1.58969099521155010221e-10;
+
+const double cosCoeff1 = 4.16666666666666019037e-02;
+const double cosCoeff2 = -1.38888888888741095749e-03;
+const double cosCoeff3 = 2.48015872894767294178e-05;
+const double cosCoeff4 = -2.75573143513906633035e-07;
+const double cosCoeff5 = 2.08757232129817482790e-09;
+const double cosCoeff6 = -1.13596475577881948265e-11;
+
+/**
+ * @brief Calculate sine and cosine of the angle in one range reduction.
+ * @param angle - angle in radians, accurate for angles within a few turns.
+ * @param sine - sine of the angle.
+ * @param cosine - cosine of the angle.
+ */
+inline void sinCos(double angle, double& sine, double& cosine) {
+    double quadrant = std::nearbyint(angle * twoOverPi);
+    double r = (angle - quadrant * pio2High) - quadrant * pio2Low;
+    double z = r * r;
+
+    double sinPoly = sinCoeff5 + z * sinCoeff6;
+    sinPoly = sinCoeff4 + z * sinPoly;
+    sinPoly = sinCoeff3 + z * sinPoly;
+    sinPoly = sinCoeff2 + z * sinPoly;
+    sinPoly = sinCoeff1 + z * sinPoly;
+    double sinR = r + r * z * sinPoly;
+
+    double cosPoly = cosCoeff5 + z * cosCoeff6;
+    cosPoly = cosCoeff4 + z * cosPoly;
+    cosPoly = cosCoeff3 + z * cosPoly;
+    cosPoly = cosCoeff2 + z * cosPoly;
+    cosPoly = cosCoeff1 + z * cosPoly;
+    double cosR = (1.0 - 0.5 * z) + z * z * cosPoly;
+
+    switch (static_cast<std::int64_t>(quadrant) & 3) {
+        case 0:
+            sine = sinR;
+            cosine = cosR;
+            break;
+        case 1:
+            sine = cosR;
+            cosine = -sinR;
+            break;
+        case 2:
+            sine = -sinR;
+            cosine = -cosR;
+            break;
+        default:
+            sine = -cosR;
+            cosine = sinR;
+            break;
+    }
+}
+
+/**
+ * @brief Convert longitudes and latitudes in degrees to map coordinates one by one.
+ * @details Same math as Coordinate_Transform_LongLat_To_ROCInner() with zero
+ * altitude. Geocentric latitude G = atan(tan(lat) / (1 + e2)) isn't computed,
+ * its sine and cosine are sin(lat) / d and (1 + e2) * cos(lat) / d where
+ * d = sqrt(sin(lat)^2 + ((1 + e2) * cos(lat))^2).
+ */
+void transformScalar(const ROC_CONTEXT& roc, const double* longitude, const double* latitude,
+                     double* xOut, double* yOut, std::size_t count) {
+    const double (*m)[3] = roc.ROC_Geocentric_Matrix;
+    const double* p = roc.ROC_Geocentric_Polar;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        double sinLong;
+        double cosLong;
+        double sinLat;
+        double cosLat;
+        sinCos(longitude[i] * degreesToRadians, sinLong, cosLong);
+        sinCos(latitude[i] * degreesToRadians, sinLat, cosLat);
+
+        // atan() keeps geocentric latitude within [-pi/2, pi/2] for any input.
+        if (cosLat < 0) {
+            sinLat = -sinLat;
+            cosLat = -cosLat;
+        }
+
+        double cosLatScaled = (1 + earthEccent2) * cosLat;
+        double d = std::sqrt(sinLat * sinLat + cosLatScaled * cosLatScaled);
+        double sinGeocent = sinLat / d;
+        double cosGeocent = cosLatScaled / d;
+        double radius = earthRadius / std::sqrt(1 + earthEccent2 * sinGeocent * sinGeocent);
+
+        double xGcs = radius * cosGeocent * cosLong - p[0];
+        double yGcs = radius * cosGeocent * sinLong - p[1];
+        double zGcs = radius * sinGeocent - p[2];
+
+        xOut[i] = m[0][0] * xGcs + m[1][0] * yGcs + m[2][0] * zGcs;
+        yOut[i] = m[0][1] * xGcs + m[1][1] * yGcs + m[2][1] * zGcs;
+    }
+}
+
+#ifdef GIS_AVX2_KERNEL
+
+/**
+ * @brief sinCos() for 4 angles.
+ */
+GIS_TARGET_AVX2 inline void sinCos4(__m256d angle, __m256d& sine, __m256d& cosine) {
+    __m256d quadrant = _mm256_round_pd(_mm256_mul_pd(angle, _mm256_set1_pd(twoOverPi)),
+                                       _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_sub_pd(angle, _mm256_mul_pd(quadrant, _mm256_set1_pd(pio2High)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(quadrant, _mm256_set1_pd(pio2Low)));
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d sinPoly = _mm256_fmadd_pd(z, _mm256_set1_pd(sinCoeff6), _mm256_set1_pd(sinCoeff5));
+    sinPoly = _mm256_fmadd_pd(z, sinPoly, _mm256_set1_pd(sinCoeff4));
+    sinPoly = _mm256_fmadd_pd(z, sinPoly, _mm256_set1_pd(sinCoeff3));
+    sinPoly = _mm256_fmadd_pd(z, sinPoly, _mm256_set1_pd(sinCoeff2));
+    sinPoly = _mm256_fmadd_pd(z, sinPoly, _mm256_set1_pd(sinCoeff1));
+    __m256d sinR = _mm256_fmadd_pd(_mm256_mul_pd(r, z), sinPoly, r);
+
+    __m256d cosPoly = _mm256_fmadd_pd(z, _mm256_set1_pd(cosCoeff6), _mm256_set1_pd(cosCoeff5));
+    cosPoly = _mm256_fmadd_pd(z, cosPoly, _mm256_set1_pd(cosCoeff4));
+    cosPoly = _mm256_fmadd_pd(z, cosPoly, _mm256_set1_pd(cosCoeff3));
+    cosPoly = _mm256_fmadd_pd(z, cosPoly, _mm256_set1_pd(cosCoeff2));
+    cosPoly = _mm256_fmadd_pd(z, cosPoly, _mm256_set1_pd(cosCoeff1));
+    __m256d cosR = _mm256_fmadd_pd(_mm256_mul_pd(z, z), cosPoly,
+                                   _mm256_fnmadd_pd(_mm256_set1_pd(0.5), z, _mm256_set1_pd(1.0)));
+
+    // Odd quadrants swap sine and cosine, bit 1 of the quadrant gives the sign.
+    __m256i quadrantBits = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(quadrant));
+    __m256i one = _mm256_set1_epi64x(1);
+    __m256i two = _mm256_set1_epi64x(2);
+    __m256d swap =
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(quadrantBits, one), one));
+    __m256d sinSign =
+        _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(quadrantBits, two), 62));
+    __m256d cosSign = _mm256_castsi256_pd(
+        _mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(quadrantBits, one), two), 62));
+
+    sine = _mm256_xor_pd(_mm256_blendv_pd(sinR, cosR, swap), sinSign);
+    cosine = _mm256_xor_pd(_mm256_blendv_pd(cosR, sinR, swap), cosSign);
+}
+
+/**
+ * @brief transformScalar() that converts 4 points per iteration.
+ */
+GIS_TARGET_AVX2 void transformAvx2(const ROC_CONTEXT& roc, const double* longitude,
+                                   const double* latitude, double* xOut, double* yOut,
+                                   std::size_t count) {
+    const double (*m)[3] = roc.ROC_Geocentric_Matrix;
+    const double* p = roc.ROC_Geocentric_Polar;
+
+    const __m256d toRadians = _mm256_set1_pd(degreesToRadians);
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    const __m256d eccentScale = _mm256_set1_pd(1 + earthEccent2);
+    const __m256d eccent2 = _mm256_set1_pd(earthEccent2);
+    const __m256d radiusEquator = _mm256_set1_pd(earthRadius);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d sinLong;
+        __m256d cosLong;
+        __m256d sinLat;
+        __m256d cosLat;
+        sinCos4(_mm256_mul_pd(_mm256_loadu_pd(longitude + i), toRadians), sinLong, cosLong);
+        sinCos4(_mm256_mul_pd(_mm256_loadu_pd(latitude + i), toRadians), sinLat, cosLat);
+
+        __m256d cosLatSign = _mm256_and_pd(cosLat, signBit);
+        sinLat = _mm256_xor_pd(sinLat, cosLatSign);
+        cosLat = _mm256_xor_pd(cosLat, cosLatSign);
+
+        __m256d cosLatScaled = _mm256_mul_pd(eccentScale, cosLat);
+        __m256d d = _mm256_sqrt_pd(
+            _mm256_fmadd_pd(sinLat, sinLat, _mm256_mul_pd(cosLatScaled, cosLatScaled)));
+        __m256d sinGeocent = _mm256_div_pd(sinLat, d);
+        __m256d cosGeocent = _mm256_div_pd(cosLatScaled, d);
+        __m256d radius = _mm256_div_pd(
+            radiusEquator,
+            _mm256_sqrt_pd(_mm256_fmadd_pd(eccent2, _mm256_mul_pd(sinGeocent, sinGeocent), one)));
+
+        __m256d radiusCos = _mm256_mul_pd(radius, cosGeocent);
+        __m256d xGcs = _mm256_fmsub_pd(radiusCos, cosLong, _mm256_set1_pd(p[0]));
+        __m256d yGcs = _mm256_fmsub_pd(radiusCos, sinLong, _mm256_set1_pd(p[1]));
+        __m256d zGcs = _mm256_fmsub_pd(radius, sinGeocent, _mm256_set1_pd(p[2]));
+
+        __m256d x = _mm256_mul_pd(_mm256_set1_pd(m[2][0]), zGcs);
+        x = _mm256_fmadd_pd(_mm256_set1_pd(m[1][0]), yGcs, x);
+        x = _mm256_fmadd_pd(_mm256_set1_pd(m[0][0]), xGcs, x);
+        __m256d y = _mm256_mul_pd(_mm256_set1_pd(m[2][1]), zGcs);
+        y = _mm256_fmadd_pd(_mm256_set1_pd(m[1][1]), yGcs, y);
+        y = _mm256_fmadd_pd(_mm256_set1_pd(m[0][1]), xGcs, y);
+
+        _mm256_storeu_pd(xOut + i, x);
+        _mm256_storeu_pd(yOut + i, y);
+    }
+
+    transformScalar(roc, longitude + i, latitude + i, xOut + i, yOut + i, count - i);
+}
+
+#endif
+
+} // namespace
 
 GisCoordinatesConverterSimple::GisCoordinatesConverterSimple(double centerLongitude,
                                                              double centerLatitude) {
-    Init_CoordinateTransformation(GA::radians(centerLongitude), GA::radians(centerLatitude), 0);
+    Init_CoordinateTransformation(&rocContext_, GA::radians(centerLongitude),
+                                  GA::radians(centerLatitude), 0);
 }
 
 GisCoordinatesConverterSimple::~GisCoordinatesConverterSimple() = default;
 
 GAPoint GisCoordinatesConverterSimple::transformCoordinate(const GAPoint &sourceCoordinate) {
     INERTIAL_POSITION outputCoordinate;
-    Coordinate_Transform_LongLat_To_ROCInner(
-        GA::radians(sourceCoordinate.x()), GA::radians(sourceCoordinate.y()), 0, &outputCoordinate);
+    Coordinate_Transform_LongLat_To_ROCInner(&rocContext_, GA::radians(sourceCoordinate.x()),
+                                             GA::radians(sourceCoordinate.y()), 0,
+                                             &outputCoordinate);
 
     return {outputCoordinate.Inertial_X_f, outputCoordinate.Inertial_Y_f};
 }
@@ -31,8 +252,46 @@ GAPoint GisCoordinatesConverterSimple::transformCoordinateBack(const GAPoint &so
     double altitude;
     double radius;
 
-    Coordinate_Transform_ROCInner_To_LongLat(&sourceCoordinateStruct, &longitudeRadians,
-                                             &latitudeRadians, &altitude, &radius);
+    Coordinate_Transform_ROCInner_To_LongLat(&rocContext_, &sourceCoordinateStruct,
+                                             &longitudeRadians, &latitudeRadians, &altitude,
+                                             &radius);
 
     return {GA::degree(longitudeRadians), GA::degree(latitudeRadians)};
 }
+
+void GisCoordinatesConverterSimple::transformCoordinates(const double *x, const double *y,
+                                                         double *xOut, double *yOut,
+                                                         std::size_t count) {
+#ifdef GIS_AVX2_KERNEL
+    if (gisCpuSupportsAvx2()) {
+        transformAvx2(rocContext_, x, y, xOut, yOut, count);
+        return;
+    }
+#endif
+
+    transformScalar(rocContext_, x, y, xOut, yOut, count);
+}
+
+void GisCoordinatesConverterSimple::transformCoordinatesBack(const double *x, const double *y,
+                                                             double *xOut, double *yOut,
+                                                             std::size_t count) {
+    INERTIAL_POSITION sourceCoordinate;
+    sourceCoordinate.Inertial_Z_f = 0;
+
+    double longitudeRadians;
+    double latitudeRadians;
+    double altitude;
+    double radius;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        sourceCoordinate.Inertial_X_f = x[i];
+        sourceCoordinate.Inertial_Y_f = y[i];
+
+        Coordinate_Transform_ROCInner_To_LongLat(&rocContext_, &sourceCoordinate,
+                                                 &longitudeRadians, &latitudeRadians, &altitude,
+                                                 &radius);
+
+        xOut[i] = GA::degree(longitudeRadians);
+        yOut[i] = GA::degree(latitudeRadians);
+    }
+}
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "coordconvert.h"
 #include "giscoordinatesconverterinterface.h"
 
+/**
+ * @brief Converter of longitude and latitude in degrees to meters on the plane
+ * tangent to the Earth at the map center.
+ * @details Every converter keeps its own map center, so converters with
+ * different centers can be used at once, also from several threads.
+ */
 class GisCoordinatesConverterSimple : public GisCoordinatesConverterInterface {
    public:
     GisCoordinatesConverterSimple(double mapCenterLongitude, double mapCenterLatitude);
@@ -9,4 +16,19 @@ class GisCoordinatesConverterSimple : public GisCoordinatesConverterInterface {
 
     virtual GAPoint transformCoordinate(const GAPoint& sourceCoordinate);
     virtual GAPoint transformCoordinateBack(const GAPoint& sourceCoordinate);
+
+    /**
+     * @brief Convert arrays of longitudes and latitudes in degrees.
+     * @details Uses AVX2 kernel on processors that support it and the same
+     * algorithm in scalar code otherwise. Trigonometry of geocentric latitude
+     * is derived algebraically, so every point takes two sine-cosine pairs.
+     * Results differ from transformCoordinate() by rounding only.
+     */
+    virtual void transformCoordinates(const double* x, const double* y, double* xOut,
+                                      double* yOut, std::size_t count);
+    virtual void transformCoordinatesBack(const double* x, const double* y, double* xOut,
+                                          double* yOut, std::size_t count);
+
+   private:
+    ROC_CONTEXT rocContext_;
 };
@@ -1,29 +1,43 @@
 #include "gisentity.h"
 
-GisEntity::GisEntity() = default;
+GisEntity::GisEntity()
+    : attributes_(nullptr), attributesRow_(0), geometry_(nullptr), geometryIndex_(0) {}
 
-GisEntity::GisEntity(const std::string& field) { fields_.emplace_back("Field", field); }
+GisEntity::GisEntity(const GisAttributeTable* attributes, std::size_t attributesRow,
+                     const GisGeometryStore* geometry, std::size_t geometryIndex)
+    : attributes_(attributes),
+      attributesRow_(attributesRow),
+      geometry_(geometry),
+      geometryIndex_(geometryIndex) {}
 
-GisEntity::GisEntity(const std::string& fieldName, const std::string& fieldValue) {
-    fields_.emplace_back(fieldName, fieldValue);
-}
+bool GisEntity::isPointsEmpty() const { return points().empty(); }
 
-GisEntity::GisEntity(std::list<GisField>& fieldsInit, std::list<GAPoint>& pointsInit) {
-    fields_.splice(fields_.begin(), fieldsInit);
-    points_.splice(points_.begin(), pointsInit);
-}
+bool GisEntity::isFieldsEmpty() const { return fieldsCount() == 0; }
+
+std::vector<GisField> GisEntity::fields() const {
+    std::vector<GisField> entityFields;
+    entityFields.reserve(fieldsCount());
+
+    for (std::size_t fieldIndex = 0; fieldIndex < fieldsCount(); ++fieldIndex) {
+        entityFields.push_back(field(fieldIndex));
+    }
 
-bool GisEntity::isPointsEmpty() const { return points_.empty(); }
+    return entityFields;
+}
 
-bool GisEntity::isFieldsEmpty() const { return fields_.empty(); }
+std::size_t GisEntity::fieldsCount() const {
+    return attributes_ ? attributes_->columnsCount() : 0;
+}
 
-const std::list<GisField>& GisEntity::fields() const { return fields_; }
+GisField GisEntity::field(std::size_t fieldIndex) const {
+    return GisField(attributes_, attributesRow_, fieldIndex);
+}
 
 std::string GisEntity::fieldsToString() const {
     std::string fieldsAsString;
 
-    if (!fields_.empty()) {
-        for (const auto& field : fields_) {
+    if (!isFieldsEmpty()) {
+        for (const auto& field : fields()) {
             fieldsAsString += field.name() + ":" + field.value() + ",";
         }
         fieldsAsString.erase(fieldsAsString.size() - 1, 1);
@@ -33,22 +47,80 @@ std::string GisEntity::fieldsToString() const {
 }
 
 std::string GisEntity::entityInfo() const {
-    std::string sizeString = std::to_string(points_.size());
+    std::string sizeString = std::to_string(points().size());
 
     return fieldsToString() + " points_count:" + sizeString;
 }
 
-const std::list<GAPoint>& GisEntity::points() const { return points_; }
+GisPointsSpan GisEntity::points() const {
+    if (!geometry_) {
+        return {};
+    }
+    return geometry_->points(geometryIndex_);
+}
+
+GisEnvelope GisEntity::envelope() const {
+    if (!geometry_) {
+        return GisEnvelope();
+    }
+    if (geometry_->hasEnvelopes()) {
+        return geometry_->envelope(geometryIndex_);
+    }
+
+    GisPointsSpan entityPoints = geometry_->points(geometryIndex_);
+    return gisPointsEnvelope(entityPoints.x(), entityPoints.y(), entityPoints.size());
+}
 
-std::list<GAPoint>& GisEntity::points() { return points_; }
+bool GisEntity::containsPoint(double x, double y) const {
+    bool isInside = false;
 
-void GisEntity::addField(const GisField& field) { fields_.push_back(field); }
+    // Every edge crossing the ray from the point to the right flips the state.
+    for (std::size_t partIndex = 0; partIndex < partsCount(); ++partIndex) {
+        GisPointsSpan ring = part(partIndex);
+        const double* ringX = ring.x();
+        const double* ringY = ring.y();
 
-void GisEntity::addPoint(const GAPoint& point) { points_.push_back(point); }
+        for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+            if ((ringY[i] > y) != (ringY[j] > y) &&
+                x < ringX[i] + (ringX[j] - ringX[i]) * (y - ringY[i]) / (ringY[j] - ringY[i])) {
+                isInside = !isInside;
+            }
+        }
+    }
+
+    return isInside;
+}
+
+std::size_t GisEntity::partsCount() const {
+    return geometry_ ? geometry_->partsCount(geometryIndex_) : 0;
+}
+
+GisPointsSpan GisEntity::part(std::size_t partIndex) const {
+    return geometry_->part(geometryIndex_, partIndex);
+}
+
+const GisGeometryStore* GisEntity::geometry() const { return geometry_; }
+
+std::size_t GisEntity::geometryIndex() const { return geometryIndex_; }
+
+void GisEntity::setGeometry(const GisGeometryStore* geometry, std::size_t geometryIndex) {
+    geometry_ = geometry;
+    geometryIndex_ = geometryIndex;
+}
+
+const GisAttributeTable* GisEntity::attributes() const { return attributes_; }
+
+std::size_t GisEntity::attributesRow() const { return attributesRow_; }
+
+void GisEntity::setAttributes(const GisAttributeTable* attributes, std::size_t attributesRow) {
+    attributes_ = attributes;
+    attributesRow_ = attributesRow;
+}
 
 GisEntity GisEntity::cloneWithoutPoints() const {
     GisEntity entity;
-    entity.fields_ = fields_;
+    entity.attributes_ = attributes_;
+    entity.attributesRow_ = attributesRow_;
 
     return entity;
 }
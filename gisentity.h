@@ -5,13 +5,20 @@
   This file contains declaration of class GisEntity.
   */
 
-#include <list>
+#include <cstddef>
+#include <string>
+#include <vector>
 
 #include "gapoint.h"
+#include "gisattributetable.h"
 #include "gisfield.h"
+#include "gisgeometrystore.h"
 
 /**
  * @brief Stores info about entity (feature) from gis files.
+ * @details Geometry and fields of the entity are not owned by it. Entity is a
+ * view into GisGeometryStore and GisAttributeTable of the layer and stays valid
+ * as long as they exist.
  */
 class GisEntity {
    public:
@@ -20,17 +27,16 @@ class GisEntity {
      */
     GisEntity();
 
-    GisEntity(const std::string& field);
-
-    GisEntity(const std::string& fieldName, const std::string& fieldValue);
-
     /**
      * @brief Constructor with initialization GisEntity::fields() and
      * GisEntity::points().
-     * @param fieldsInit - to initialize GisEntity::fields().
-     * @param pointsInit - to initialize GisEntity::points().
+     * @param attributes - attribute table that contains fields of the entity.
+     * @param attributesRow - index of the row of the entity inside of attributes.
+     * @param geometry - store that contains points of the entity.
+     * @param geometryIndex - index of the entity inside of geometry.
      */
-    GisEntity(std::list<GisField>& fieldsInit, std::list<GAPoint>& pointsInit);
+    GisEntity(const GisAttributeTable* attributes, std::size_t attributesRow,
+              const GisGeometryStore* geometry, std::size_t geometryIndex);
 
     /**
      * @brief Is GisEntity::points() empty.
@@ -46,36 +52,84 @@ class GisEntity {
 
     /**
      * @brief Get list of fields.
-     * @return List of fields.
+     * @return Views of the fields inside of the attribute table.
+     */
+    std::vector<GisField> fields() const;
+
+    std::size_t fieldsCount() const;
+
+    /**
+     * @brief Get one field of the entity.
+     * @param fieldIndex - index of the field (column of the attribute table).
+     * @return View of the field inside of the attribute table.
      */
-    const std::list<GisField>& fields() const;
+    GisField field(std::size_t fieldIndex) const;
 
     std::string fieldsToString() const;
 
     std::string entityInfo() const;
 
     /**
-     * @brief Get list of points.
-     * @return List of points.
+     * @brief Get all points of the entity.
+     * @return View of the points inside of the geometry store.
+     */
+    GisPointsSpan points() const;
+
+    /**
+     * @brief Get number of parts (rings) of the entity.
+     * @return Number of parts.
+     */
+    std::size_t partsCount() const;
+
+    /**
+     * @brief Get points of one part (ring) of the entity.
+     * @param partIndex - index of the part.
+     * @return View of the points inside of the geometry store.
+     */
+    GisPointsSpan part(std::size_t partIndex) const;
+
+    /**
+     * @brief Get bounding box of the points of the entity.
+     * @details Envelope stored in the geometry store is used if it has
+     * envelopes, otherwise it is computed from the points.
+     * @return Envelope of the points, empty if the entity has none.
      */
-    const std::list<GAPoint>& points() const;
-    std::list<GAPoint>& points();
+    GisEnvelope envelope() const;
 
     /**
-     * @brief Adds new field into GisEntity::fields().
-     * @param field	- field to add.
+     * @brief Check whether the point is inside of the entity by the even-odd
+     * rule over all its parts.
+     * @details A point inside of a hole or of two overlapping parts is
+     * outside. Points on the boundary may be either inside or outside.
+     * @return True - if the point is inside. False - otherwise.
      */
-    void addField(const GisField& field);
+    bool containsPoint(double x, double y) const;
+
+    const GisGeometryStore* geometry() const;
+    std::size_t geometryIndex() const;
+
+    /**
+     * @brief Bind the entity to its geometry.
+     * @param geometry - store that contains points of the entity.
+     * @param geometryIndex - index of the entity inside of geometry.
+     */
+    void setGeometry(const GisGeometryStore* geometry, std::size_t geometryIndex);
+
+    const GisAttributeTable* attributes() const;
+    std::size_t attributesRow() const;
 
     /**
-     * @brief Adds new point into GisEntity::points().
-     * @param point	- point to add.
+     * @brief Bind the entity to its fields.
+     * @param attributes - attribute table that contains fields of the entity.
+     * @param attributesRow - index of the row of the entity inside of attributes.
      */
-    void addPoint(const GAPoint& point);
+    void setAttributes(const GisAttributeTable* attributes, std::size_t attributesRow);
 
     GisEntity cloneWithoutPoints() const;
 
    private:
-    std::list<GisField> fields_;
-    std::list<GAPoint> points_;
+    const GisAttributeTable* attributes_;
+    std::size_t attributesRow_;
+    const GisGeometryStore* geometry_;
+    std::size_t geometryIndex_;
 };
@@ -0,0 +1,130 @@
+#include "gisenvelope.h"
+
+#include "gissimd.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+/**
+ * @brief Find minimum and maximum of values.
+ * @details Four independent accumulators let the compiler use vector
+ * instructions and hide latency of comparisons.
+ */
+void minMaxScalar(const double *values, std::size_t count, double &minValue, double &maxValue) {
+    double minValues[4] = {minValue, minValue, minValue, minValue};
+    double maxValues[4] = {maxValue, maxValue, maxValue, maxValue};
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+            double value = values[i + lane];
+            minValues[lane] = value < minValues[lane] ? value : minValues[lane];
+            maxValues[lane] = value > maxValues[lane] ? value : maxValues[lane];
+        }
+    }
+    for (; i < count; ++i) {
+        minValues[0] = std::min(minValues[0], values[i]);
+        maxValues[0] = std::max(maxValues[0], values[i]);
+    }
+
+    minValue = *std::min_element(minValues, minValues + 4);
+    maxValue = *std::max_element(maxValues, maxValues + 4);
+}
+
+#ifdef GIS_AVX2_KERNEL
+
+/**
+ * @brief Envelope of at least one point with AVX2 instructions.
+ */
+GIS_TARGET_AVX2 GisEnvelope envelopeAvx2(const double *x, const double *y, std::size_t count) {
+    double minX = std::numeric_limits<double>::max();
+    double minY = std::numeric_limits<double>::max();
+    double maxX = std::numeric_limits<double>::lowest();
+    double maxY = std::numeric_limits<double>::lowest();
+
+    std::size_t i = 0;
+    if (count >= 4) {
+        __m256d minX4 = _mm256_loadu_pd(x);
+        __m256d maxX4 = minX4;
+        __m256d minY4 = _mm256_loadu_pd(y);
+        __m256d maxY4 = minY4;
+
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m256d x4 = _mm256_loadu_pd(x + i);
+            __m256d y4 = _mm256_loadu_pd(y + i);
+            minX4 = _mm256_min_pd(minX4, x4);
+            maxX4 = _mm256_max_pd(maxX4, x4);
+            minY4 = _mm256_min_pd(minY4, y4);
+            maxY4 = _mm256_max_pd(maxY4, y4);
+        }
+
+        double lanes[4][4];
+        _mm256_storeu_pd(lanes[0], minX4);
+        _mm256_storeu_pd(lanes[1], minY4);
+        _mm256_storeu_pd(lanes[2], maxX4);
+        _mm256_storeu_pd(lanes[3], maxY4);
+        minX = *std::min_element(lanes[0], lanes[0] + 4);
+        minY = *std::min_element(lanes[1], lanes[1] + 4);
+        maxX = *std::max_element(lanes[2], lanes[2] + 4);
+        maxY = *std::max_element(lanes[3], lanes[3] + 4);
+    }
+
+    for (; i < count; ++i) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+    }
+
+    return GisEnvelope(minX, minY, maxX, maxY);
+}
+
+#endif
+
+} // namespace
+
+GisEnvelope::GisEnvelope()
+    : minX_(std::numeric_limits<double>::max()),
+      minY_(std::numeric_limits<double>::max()),
+      maxX_(std::numeric_limits<double>::lowest()),
+      maxY_(std::numeric_limits<double>::lowest()) {}
+
+GisEnvelope::GisEnvelope(double minX, double minY, double maxX, double maxY)
+    : minX_(minX), minY_(minY), maxX_(maxX), maxY_(maxY) {}
+
+void GisEnvelope::expand(double x, double y) {
+    minX_ = std::min(minX_, x);
+    minY_ = std::min(minY_, y);
+    maxX_ = std::max(maxX_, x);
+    maxY_ = std::max(maxY_, y);
+}
+
+void GisEnvelope::expand(const GisEnvelope &other) {
+    minX_ = std::min(minX_, other.minX_);
+    minY_ = std::min(minY_, other.minY_);
+    maxX_ = std::max(maxX_, other.maxX_);
+    maxY_ = std::max(maxY_, other.maxY_);
+}
+
+GisEnvelope gisPointsEnvelope(const double *x, const double *y, std::size_t count) {
+    if (count == 0) {
+        return GisEnvelope();
+    }
+
+#ifdef GIS_AVX2_KERNEL
+    if (gisCpuSupportsAvx2()) {
+        return envelopeAvx2(x, y, count);
+    }
+#endif
+
+    double minX = std::numeric_limits<double>::max();
+    double maxX = std::numeric_limits<double>::lowest();
+    double minY = minX;
+    double maxY = maxX;
+    minMaxScalar(x, count, minX, maxX);
+    minMaxScalar(y, count, minY, maxY);
+
+    return GisEnvelope(minX, minY, maxX, maxY);
+}
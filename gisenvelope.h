@@ -0,0 +1,86 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisEnvelope.
+  */
+
+#include <cstddef>
+
+/**
+ * @brief Axis-aligned bounding box of points.
+ * @details Default envelope is empty: it contains nothing and intersects
+ * nothing, expanding it by a point gives the envelope of that point.
+ */
+class GisEnvelope {
+   public:
+    GisEnvelope();
+    GisEnvelope(double minX, double minY, double maxX, double maxY);
+
+    double minX() const { return minX_; }
+    double minY() const { return minY_; }
+    double maxX() const { return maxX_; }
+    double maxY() const { return maxY_; }
+
+    /**
+     * @brief Check whether the envelope has no points.
+     * @return True - if the envelope is empty. False - otherwise.
+     */
+    bool isEmpty() const { return minX_ > maxX_ || minY_ > maxY_; }
+
+    /**
+     * @brief Extend the envelope to contain the point.
+     */
+    void expand(double x, double y);
+
+    /**
+     * @brief Extend the envelope to contain the other one.
+     */
+    void expand(const GisEnvelope& other);
+
+    /**
+     * @brief Check whether envelopes have common points, touching counts.
+     * @return True - if envelopes intersect. False - otherwise or if any is empty.
+     */
+    bool intersects(const GisEnvelope& other) const {
+        return minX_ <= other.maxX_ && maxX_ >= other.minX_ && minY_ <= other.maxY_ &&
+               maxY_ >= other.minY_;
+    }
+
+    /**
+     * @brief Check whether the other envelope lies inside of this one.
+     * @return True - if the other envelope is inside, boundaries included.
+     * False - otherwise.
+     */
+    bool contains(const GisEnvelope& other) const {
+        return other.minX_ >= minX_ && other.maxX_ <= maxX_ && other.minY_ >= minY_ &&
+               other.maxY_ <= maxY_;
+    }
+
+    bool contains(double x, double y) const {
+        return x >= minX_ && x <= maxX_ && y >= minY_ && y <= maxY_;
+    }
+
+    bool operator==(const GisEnvelope& other) const {
+        return minX_ == other.minX_ && minY_ == other.minY_ && maxX_ == other.maxX_ &&
+               maxY_ == other.maxY_;
+    }
+
+    bool operator!=(const GisEnvelope& other) const { return !(*this == other); }
+
+   private:
+    double minX_;
+    double minY_;
+    double maxX_;
+    double maxY_;
+};
+
+/**
+ * @brief Compute envelope of points with a vectorized min/max reduction.
+ * @details Uses AVX2 kernel on processors that support it.
+ * @param x - X coordinates of points.
+ * @param y - Y coordinates of points.
+ * @param count - number of points.
+ * @return Envelope of the points, empty if count is 0.
+ */
+GisEnvelope gisPointsEnvelope(const double* x, const double* y, std::size_t count);
@@ -1,14 +1,18 @@
 #include "gisfield.h"
 
-#include <utility>
+#include "gisattributetable.h"
 
-GisField::GisField(std::string name, std::string value)
-    : name_(std::move(name)), value_(std::move(value)) {}
+GisField::GisField(const GisAttributeTable *table, std::size_t row, std::size_t column)
+    : table_(table), row_(row), column_(column) {}
 
-std::string GisField::name() const { return name_; }
+const std::string &GisField::name() const { return table_->columnName(column_); }
 
-void GisField::setName(const std::string &name) { name_ = name; }
+std::string GisField::value() const { return table_->valueAsString(row_, column_); }
 
-std::string GisField::value() const { return value_; }
+bool GisField::isNull() const { return table_->isNull(row_, column_); }
 
-void GisField::setValue(const std::string &value) { value_ = value; }
+std::int64_t GisField::valueAsInt() const { return table_->valueAsInt(row_, column_); }
+
+double GisField::valueAsDouble() const { return table_->valueAsDouble(row_, column_); }
+
+std::string GisField::valueAsString() const { return table_->valueAsString(row_, column_); }
@@ -5,30 +5,32 @@
   This file contains declaration of class GisField.
   */
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
+class GisAttributeTable;
+
 /**
  * @brief Stores info about field from gis files.
+ * @details Field is a view of a cell of GisAttributeTable of the layer and
+ * stays valid as long as the table exists.
  */
 class GisField {
    public:
     /**
-     * @brief Initialize with name of field and it's value.
-     * @param name - name of the field.
-     * @param value - value of the field.
+     * @brief Initialize with cell of the attribute table.
+     * @param table - attribute table of the layer.
+     * @param row - index of the row of the entity.
+     * @param column - index of the column of the field.
      */
-    GisField(std::string name, std::string value);
+    GisField(const GisAttributeTable* table, std::size_t row, std::size_t column);
 
     /**
      * @brief Get name of the field.
      * @return name of the vield.
      */
-    std::string name() const;
-
-    /**
-     * @brief Set name of the field.
-     */
-    void setName(const std::string& name);
+    const std::string& name() const;
 
     /**
      * @brief Get value of the field.
@@ -37,32 +39,31 @@ class GisField {
     std::string value() const;
 
     /**
-     * @brief Set value of the field.
+     * @brief Whether the field has no value.
+     * @return True - if value of the field is null. False - otherwise.
      */
-    void setValue(const std::string& value);
+    bool isNull() const;
 
     /**
      * @brief Get value of the field as integer.
-     * @warning Not implemented.
-     * @return value of the field as integer.
+     * @return value of the field as integer, 0 if it can't be converted.
      */
-    int valueAsInt() const;
+    std::int64_t valueAsInt() const;
 
     /**
      * @brief Get value of the field as double.
-     * @warning Not implemented.
-     * @return value of the field as double.
+     * @return value of the field as double, 0 if it can't be converted.
      */
     double valueAsDouble() const;
 
     /**
      * @brief Get value of the field as std::string.
-     * @warning Not implemented.
      * @return value of the field as std::string.
      */
     std::string valueAsString() const;
 
    private:
-    std::string name_;
-    std::string value_;
+    const GisAttributeTable* table_;
+    std::size_t row_;
+    std::size_t column_;
 };
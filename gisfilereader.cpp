@@ -1,52 +1,308 @@
 #include "gisfilereader.h"
 
 #include "clipper.hpp"
+#include "gisparallel.h"
+#include "gisrectangleclipper.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
 #include <utility>
 
 
 namespace {
 
-const int precision = 100;
+// Largest coordinate Clipper handles with 64-bit arithmetic, see loRange in clipper.cpp.
+const double clipperRange = 1073741823.0;
 
-ClipperLib::Path pathFromRectangle(double clipAreaLeft, double clipAreaTop,
-                                                  double clipAreaRight, double clipAreaBottom) {
+// Smaller tasks don't pay off the overhead of scheduling them.
+const std::size_t minPointsPerClipTask = 16 * 1024;
 
-    long long left = std::llround(clipAreaLeft * precision);
-    long long top = std::llround(clipAreaTop * precision);
-    long long right = std::llround(clipAreaRight * precision);
-    long long bottom = std::llround(clipAreaBottom * precision);
+/**
+ * @brief Mapping of coordinates to integer coordinates of Clipper.
+ * @details Coordinates are shifted to the origin and multiplied by the scale.
+ */
+struct ClipperGrid {
+    double originX;
+    double originY;
+    double scale;
 
+    ClipperLib::IntPoint toInt(double x, double y) const {
+        return ClipperLib::IntPoint(std::llround((x - originX) * scale),
+                                    std::llround((y - originY) * scale));
+    }
+};
+
+/**
+ * @brief Choose the finest grid for points inside of the envelope.
+ * @details The origin is the center of the envelope and the scale is the
+ * largest power of two keeping coordinates within clipperRange. So Clipper
+ * never falls back to 128-bit arithmetic, and scaling itself is exact.
+ * @param envelope - envelope of all points to clip.
+ * @return Grid of the envelope, unit grid if it is empty or a point.
+ */
+ClipperGrid clipperGrid(const GisEnvelope &envelope) {
+    if (envelope.isEmpty()) {
+        return {0, 0, 1};
+    }
+
+    double originX = (envelope.minX() + envelope.maxX()) / 2;
+    double originY = (envelope.minY() + envelope.maxY()) / 2;
+    double halfSize = std::max(envelope.maxX() - originX, envelope.maxY() - originY);
+    if (!(halfSize > 0)) {
+        return {originX, originY, 1};
+    }
+
+    int exponent = static_cast<int>(std::floor(std::log2(clipperRange / halfSize)));
+    return {originX, originY, std::ldexp(1.0, exponent)};
+}
+
+ClipperLib::Path pathFromRectangle(const ClipperGrid &grid, double clipAreaLeft,
+                                   double clipAreaTop, double clipAreaRight,
+                                   double clipAreaBottom) {
+    ClipperLib::Path path;
+    path.push_back(grid.toInt(clipAreaLeft, clipAreaTop));
+    path.push_back(grid.toInt(clipAreaRight, clipAreaTop));
+    path.push_back(grid.toInt(clipAreaRight, clipAreaBottom));
+    path.push_back(grid.toInt(clipAreaLeft, clipAreaBottom));
+
+    return path;
+}
+
+ClipperLib::Path pathFromPolygon(const ClipperGrid &grid, const std::vector<GAPoint> &polygon) {
     ClipperLib::Path path;
-    path.push_back(ClipperLib::IntPoint(left, top));
-    path.push_back(ClipperLib::IntPoint(right, top));
-    path.push_back(ClipperLib::IntPoint(right, bottom));
-    path.push_back(ClipperLib::IntPoint(left, bottom));
+    path.reserve(polygon.size());
+    for (const GAPoint &point : polygon) {
+        path.push_back(grid.toInt(point.x(), point.y()));
+    }
 
     return path;
 }
 
-void fillPathFromEntity(ClipperLib::Path &path, const GisEntity &entity) {
-    for (const auto &pointEntity : entity.points()) {
+void fillPathsFromEntity(const ClipperGrid &grid, ClipperLib::Paths &paths,
+                         const GisEntity &entity) {
+    paths.resize(entity.partsCount());
 
-        path.push_back(ClipperLib::IntPoint(std::llround(pointEntity.x() * precision),
-                                            std::llround(pointEntity.y() * precision)));
+    for (std::size_t partIndex = 0; partIndex < entity.partsCount(); ++partIndex) {
+        GisPointsSpan part = entity.part(partIndex);
+        ClipperLib::Path &path = paths[partIndex];
+        path.clear();
+        path.reserve(part.size());
+
+        for (std::size_t i = 0; i < part.size(); ++i) {
+            path.push_back(grid.toInt(part.x()[i], part.y()[i]));
+        }
     }
 }
 
-void fillEntityFromPath(GisEntity &entity, const ClipperLib::Path &path) {
+/**
+ * @brief Append the ring to the current part, repeating its first vertex at
+ * the end as files do.
+ */
+void fillGeometryFromPath(const ClipperGrid &grid, GisGeometryStore &geometry,
+                          const ClipperLib::Path &path) {
     for (auto point : path) {
-        double x = static_cast<double>(point.X) / precision;
-        double y = static_cast<double>(point.Y) / precision;
-        entity.addPoint(GAPoint(x, y));
+        double x = grid.originX + static_cast<double>(point.X) / grid.scale;
+        double y = grid.originY + static_cast<double>(point.Y) / grid.scale;
+        geometry.addPoint(x, y);
+    }
+    if (!path.empty()) {
+        geometry.addPoint(grid.originX + static_cast<double>(path.front().X) / grid.scale,
+                          grid.originY + static_cast<double>(path.front().Y) / grid.scale);
     }
 }
 
-} // namespace
+/**
+ * @brief Append an entity per outer ring below the node, holes of a ring
+ * become further parts of its entity.
+ * @param node - node whose children are outer rings.
+ * @param entity - clipped entity to take fields from.
+ */
+void fillEntitiesFromPolyNode(const ClipperGrid &grid, const ClipperLib::PolyNode &node,
+                              const GisEntity &entity, GisGeometryStore &geometry,
+                              std::vector<GisEntity> &entities) {
+    for (const ClipperLib::PolyNode *outer : node.Childs) {
+        entities.push_back(entity.cloneWithoutPoints());
+        entities.back().setGeometry(&geometry, geometry.beginEntity());
+        fillGeometryFromPath(grid, geometry, outer->Contour);
+
+        for (const ClipperLib::PolyNode *hole : outer->Childs) {
+            geometry.beginPart();
+            fillGeometryFromPath(grid, geometry, hole->Contour);
+        }
+
+        // Islands inside of holes are entities of their own.
+        for (const ClipperLib::PolyNode *hole : outer->Childs) {
+            fillEntitiesFromPolyNode(grid, *hole, entity, geometry, entities);
+        }
+    }
+}
+
+/**
+ * @brief Intersection of entities with a clip area by Clipper, buffers are
+ * reused between entities.
+ */
+class ClipperAreaClipper {
+   public:
+    /**
+     * @param clipFillType - rule for the inside of the clip area, it matters
+     * only if the area intersects itself.
+     */
+    ClipperAreaClipper(const ClipperGrid &grid, const ClipperLib::Path &clipArea,
+                       ClipperLib::PolyFillType clipFillType)
+        : grid_(grid), clipArea_(clipArea), clipFillType_(clipFillType) {}
+
+    /**
+     * @brief Append an entity per polygon of the intersection, parts of the
+     * entity are rings and holes are told by the even-odd rule.
+     */
+    void clipPolygon(const GisEntity &entity, GisGeometryStore &geometry,
+                     std::vector<GisEntity> &entities) {
+        fillPathsFromEntity(grid_, pointsSource_, entity);
+
+        clipper_.Clear();
+        clipper_.AddPaths(pointsSource_, ClipperLib::ptSubject, true);
+        clipper_.AddPath(clipArea_, ClipperLib::ptClip, true);
+        clipper_.Execute(ClipperLib::ctIntersection, clippedArea_, ClipperLib::pftEvenOdd,
+                         clipFillType_);
+
+        fillEntitiesFromPolyNode(grid_, clippedArea_, entity, geometry, entities);
+    }
+
+   private:
+    const ClipperGrid &grid_;
+    const ClipperLib::Path &clipArea_;
+    ClipperLib::PolyFillType clipFillType_;
+    ClipperLib::Clipper clipper_;
+    ClipperLib::Paths pointsSource_;
+    ClipperLib::PolyTree clippedArea_;
+};
+
+/**
+ * @brief Position of an envelope relative to a polygon.
+ */
+enum EnvelopePosition { EnvelopeOutside, EnvelopeInside, EnvelopeCrossing };
+
+/**
+ * @brief Check whether the segment has common points with the envelope.
+ */
+bool isSegmentTouchingEnvelope(const GAPoint &a, const GAPoint &b, const GisEnvelope &envelope) {
+    GisEnvelope segment(std::min(a.x(), b.x()), std::min(a.y(), b.y()), std::max(a.x(), b.x()),
+                        std::max(a.y(), b.y()));
+    if (!segment.intersects(envelope)) {
+        return false;
+    }
+
+    // Otherwise they are apart only if all corners are strictly on one side of the line.
+    auto side = [&](double x, double y) {
+        return (b.x() - a.x()) * (y - a.y()) - (b.y() - a.y()) * (x - a.x());
+    };
+    double sides[4] = {side(envelope.minX(), envelope.minY()),
+                       side(envelope.maxX(), envelope.minY()),
+                       side(envelope.maxX(), envelope.maxY()),
+                       side(envelope.minX(), envelope.maxY())};
+
+    return !(std::all_of(sides, sides + 4, [](double value) { return value > 0; }) ||
+             std::all_of(sides, sides + 4, [](double value) { return value < 0; }));
+}
+
+/**
+ * @brief Count how many times the polygon winds around the point.
+ */
+int windingNumber(const std::vector<GAPoint> &polygon, double x, double y) {
+    int winding = 0;
+
+    for (std::size_t i = 0; i < polygon.size(); ++i) {
+        const GAPoint &a = polygon[i];
+        const GAPoint &b = polygon[(i + 1) % polygon.size()];
+        double side = (b.x() - a.x()) * (y - a.y()) - (b.y() - a.y()) * (x - a.x());
+
+        if (a.y() <= y) {
+            if (b.y() > y && side > 0) {
+                ++winding;
+            }
+        } else if (b.y() <= y && side < 0) {
+            --winding;
+        }
+    }
+
+    return winding;
+}
+
+/**
+ * @brief Find position of the envelope relative to the polygon filled by the
+ * non-zero rule.
+ * @param polygonEnvelope - envelope of the polygon.
+ */
+EnvelopePosition envelopePosition(const std::vector<GAPoint> &polygon,
+                                  const GisEnvelope &polygonEnvelope,
+                                  const GisEnvelope &envelope) {
+    if (!polygonEnvelope.intersects(envelope)) {
+        return EnvelopeOutside;
+    }
+
+    for (std::size_t i = 0; i < polygon.size(); ++i) {
+        if (isSegmentTouchingEnvelope(polygon[i], polygon[(i + 1) % polygon.size()], envelope)) {
+            return EnvelopeCrossing;
+        }
+    }
+
+    // No edge reaches the envelope, so every its point is wound around the same number of times.
+    return windingNumber(polygon, envelope.minX(), envelope.minY()) != 0 ? EnvelopeInside
+                                                                         : EnvelopeOutside;
+}
+
+/**
+ * @brief Append geometry of the entity with all its parts to the store.
+ * @param geometry - store to append to.
+ * @param entity - entity to copy points of.
+ * @return Index of the new entity inside of the geometry store.
+ */
+std::size_t copyEntityGeometry(GisGeometryStore &geometry, const GisEntity &entity) {
+    std::size_t geometryIndex = geometry.beginEntity();
+
+    for (std::size_t partIndex = 0; partIndex < entity.partsCount(); ++partIndex) {
+        GisPointsSpan part = entity.part(partIndex);
+        geometry.beginPart();
+        geometry.addPoints(part.x(), part.y(), part.size());
+    }
+
+    return geometryIndex;
+}
 
-GisFileReader::GisFileReader() = default;
+/**
+ * @brief Get bounding box of the points of all entities.
+ */
+GisEnvelope entitiesEnvelope(const std::vector<GisEntity> &entities) {
+    GisEnvelope envelope;
+    for (const GisEntity &entity : entities) {
+        envelope.expand(entity.envelope());
+    }
+
+    return envelope;
+}
+
+} // namespace
 
-GisFileReader::GisFileReader(std::string filename) : filename_(std::move(filename)) {}
+GisFileReader::GisFileReader()
+    : geometry_(new GisGeometryStore),
+      attributes_(new GisAttributeTable),
+      fieldsProjection_(false),
+      pointsConverter_(nullptr),
+      clipMethod_(ClipMethodRectangle),
+      clipThreadsCount_(0),
+      isEntitiesTreeValid_(false) {}
+
+GisFileReader::GisFileReader(std::string filename)
+    : geometry_(new GisGeometryStore),
+      attributes_(new GisAttributeTable),
+      filename_(std::move(filename)),
+      fieldsProjection_(false),
+      pointsConverter_(nullptr),
+      clipMethod_(ClipMethodRectangle),
+      clipThreadsCount_(0),
+      isEntitiesTreeValid_(false) {}
 
 GisFileReader::~GisFileReader() = default;
 
@@ -55,6 +311,56 @@ bool GisFileReader::readFile(const std::string &filename) {
     return readFile();
 }
 
+bool GisFileReader::forEachEntity(const EntityVisitor &visitor) {
+    if (!readFile()) {
+        return false;
+    }
+
+    for (const auto &entity : entities_) {
+        if (!visitor(entity)) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool GisFileReader::readFileInRect(double minX, double minY, double maxX, double maxY) {
+    // The rectangle is in coordinates of the file, kept entities are converted after it.
+    GisCoordinatesConverterInterface *pointsConverter = pointsConverter_;
+    pointsConverter_ = nullptr;
+    bool readResult = readFile();
+    pointsConverter_ = pointsConverter;
+
+    if (!readResult) {
+        return false;
+    }
+
+    std::vector<GisEntity> entities;
+    std::unique_ptr<GisGeometryStore> geometry(new GisGeometryStore);
+    GisEnvelope rect(minX, minY, maxX, maxY);
+
+    for (const auto &entity : entities_) {
+        if (entity.envelope().intersects(rect)) {
+            entities.push_back(entity);
+            entities.back().setGeometry(geometry.get(), copyEntityGeometry(*geometry, entity));
+        }
+    }
+
+    entities_.swap(entities);
+    geometry_ = std::move(geometry);
+
+    if (pointsConverter_) {
+        for (const auto &entity : entities_) {
+            convertEntityPoints(*geometry_, entity.geometryIndex());
+        }
+        fillLimitsFromGeometry();
+    }
+    geometry_->updateEnvelopes();
+
+    return true;
+}
+
 double GisFileReader::maxX() const { return maxX_; }
 
 double GisFileReader::minX() const { return minX_; }
@@ -63,13 +369,107 @@ double GisFileReader::maxY() const { return maxY_; }
 
 double GisFileReader::minY() const { return minY_; }
 
+GisEnvelope GisFileReader::envelope() const { return GisEnvelope(minX_, minY_, maxX_, maxY_); }
+
 std::string GisFileReader::filename() const { return filename_; }
 
 void GisFileReader::setFilename(const std::string &filename) { filename_ = filename; }
 
-const std::list<GisEntity> &GisFileReader::entities() const { return entities_; }
+const std::vector<GisEntity> &GisFileReader::entities() const { return entities_; }
+
+const GisGeometryStore &GisFileReader::geometry() const { return *geometry_; }
+
+const GisAttributeTable &GisFileReader::attributes() const { return *attributes_; }
+
+void GisFileReader::setFieldsProjection(const std::vector<std::string> &fieldNames) {
+    fieldsProjection_ = true;
+    projectedFieldNames_ = fieldNames;
+    projectedFieldIndices_.clear();
+}
+
+void GisFileReader::setFieldsProjectionByIndex(const std::vector<int> &fieldIndices) {
+    fieldsProjection_ = true;
+    projectedFieldNames_.clear();
+    projectedFieldIndices_ = fieldIndices;
+}
+
+void GisFileReader::resetFieldsProjection() {
+    fieldsProjection_ = false;
+    projectedFieldNames_.clear();
+    projectedFieldIndices_.clear();
+}
 
-std::list<GisEntity> &GisFileReader::entities() { return entities_; }
+bool GisFileReader::hasFieldsProjection() const { return fieldsProjection_; }
+
+GisCoordinatesConverterInterface *GisFileReader::pointsConverter() const {
+    return pointsConverter_;
+}
+
+void GisFileReader::setPointsConverter(GisCoordinatesConverterInterface *pointsConverter) {
+    pointsConverter_ = pointsConverter;
+}
+
+std::vector<int> GisFileReader::projectedFields(const std::vector<std::string> &fieldNames) const {
+    std::vector<int> fields;
+
+    for (int field = 0; field < static_cast<int>(fieldNames.size()); ++field) {
+        if (!fieldsProjection_ ||
+            std::find(projectedFieldNames_.begin(), projectedFieldNames_.end(),
+                      fieldNames[field]) != projectedFieldNames_.end() ||
+            std::find(projectedFieldIndices_.begin(), projectedFieldIndices_.end(), field) !=
+                projectedFieldIndices_.end()) {
+            fields.push_back(field);
+        }
+    }
+
+    return fields;
+}
+
+bool GisFileReader::isGeometryOnly() const {
+    return fieldsProjection_ && projectedFieldNames_.empty() && projectedFieldIndices_.empty();
+}
+
+void GisFileReader::convertEntityPoints(GisGeometryStore &geometry,
+                                        std::size_t geometryIndex) const {
+    GisPointsSpan points = geometry.points(geometryIndex);
+    if (!pointsConverter_ || points.empty()) {
+        return;
+    }
+
+    // Points of the entity are contiguous, so they are converted in one call.
+    std::size_t first = points.x() - geometry.xData();
+    pointsConverter_->transformCoordinates(points.x(), points.y(), geometry.xData() + first,
+                                           geometry.yData() + first, points.size());
+}
+
+void GisFileReader::fillLimitsFromGeometry() {
+    geometry_->updateEnvelopes();
+    const GisEnvelope &envelope = geometry_->envelope();
+
+    if (envelope.isEmpty()) {
+        minX_ = minY_ = maxX_ = maxY_ = 0;
+        return;
+    }
+
+    minX_ = envelope.minX();
+    minY_ = envelope.minY();
+    maxX_ = envelope.maxX();
+    maxY_ = envelope.maxY();
+}
+
+void GisFileReader::takeEntities(GisFileReader &reader) {
+    entities_ = std::move(reader.entities_);
+    reader.entities_.clear();
+
+    // Entities point to the store object, it is moved as a whole.
+    geometry_ = std::move(reader.geometry_);
+    reader.geometry_.reset(new GisGeometryStore);
+
+    minX_ = reader.minX_;
+    minY_ = reader.minY_;
+    maxX_ = reader.maxX_;
+    maxY_ = reader.maxY_;
+}
 
 int GisFileReader::entitiesPointsCount() const {
     int pointsCount = 0;
@@ -80,36 +480,263 @@ int GisFileReader::entitiesPointsCount() const {
     return pointsCount;
 }
 
-void GisFileReader::clipPolygons(double clipAreaLeft, double clipAreaTop, double clipAreaRight,
-                                 double clipAreaBottom) {
-    entitiesClipBackup_.clear();
-    entitiesClipBackup_.splice(entitiesClipBackup_.begin(), entities_);
+bool GisFileReader::clipPolygons(double clipAreaLeft, double clipAreaTop, double clipAreaRight,
+                                 double clipAreaBottom, const ClipProgress &progress) {
+    GisEnvelope clipEnvelope(
+        std::min(clipAreaLeft, clipAreaRight), std::min(clipAreaTop, clipAreaBottom),
+        std::max(clipAreaLeft, clipAreaRight), std::max(clipAreaTop, clipAreaBottom));
+
+    // Clipper gets only entities crossing the area, so cutting the area by the
+    // layer envelope changes nothing and keeps it on the grid of the layer. If
+    // the area misses the layer, or the layer is empty, no entity crosses it.
+    GisEnvelope layerEnvelope = entitiesEnvelope(entities_);
+    ClipperGrid grid = clipperGrid(layerEnvelope);
+    ClipperLib::Path clipArea;
+    if (layerEnvelope.intersects(clipEnvelope)) {
+        clipArea = pathFromRectangle(grid, std::max(clipEnvelope.minX(), layerEnvelope.minX()),
+                                     std::min(clipEnvelope.maxY(), layerEnvelope.maxY()),
+                                     std::min(clipEnvelope.maxX(), layerEnvelope.maxX()),
+                                     std::max(clipEnvelope.minY(), layerEnvelope.minY()));
+    }
 
-    ClipperLib::Path clipArea =
-        pathFromRectangle(clipAreaLeft, clipAreaTop, clipAreaRight, clipAreaBottom);
+    auto clipTask = [&](std::size_t firstEntity, std::size_t endEntity, ClipTaskResult &result) {
+        // Buffers are reused between entities of the task to avoid allocations per entity.
+        GisRectangleClipper rectangleClipper(clipEnvelope);
+        ClipperAreaClipper areaClipper(grid, clipArea, ClipperLib::pftEvenOdd);
+
+        for (std::size_t entityIndex = firstEntity; entityIndex < endEntity; ++entityIndex) {
+            const GisEntity &entity = entities_[entityIndex];
+
+            // Only entities crossing the boundary of the area need clipping.
+            GisEnvelope entityEnvelope = entity.envelope();
+            if (!clipEnvelope.intersects(entityEnvelope)) {
+                result.changes.push_back({entityIndex, 0, entity});
+                continue;
+            }
+            if (clipEnvelope.contains(entityEnvelope)) {
+                result.entities.push_back(entity);
+                continue;
+            }
+
+            std::size_t resultsBegin = result.entities.size();
+            if (clipMethod_ == ClipMethodRectangle) {
+                std::size_t geometryIndex = 0;
+                if (rectangleClipper.clipPolygon(entity, result.geometry, geometryIndex)) {
+                    result.entities.push_back(entity.cloneWithoutPoints());
+                    result.entities.back().setGeometry(&result.geometry, geometryIndex);
+                }
+            } else {
+                areaClipper.clipPolygon(entity, result.geometry, result.entities);
+            }
+            result.changes.push_back({entityIndex, result.entities.size() - resultsBegin, entity});
+        }
+    };
 
-    for (const auto &entity : entitiesClipBackup_)  {
-        ClipperLib::Path pointsSource;
-        fillPathFromEntity(pointsSource, entity);
+    return clipEntities(clipTask, progress);
+}
 
-        ClipperLib::Clipper clipper;
-        clipper.AddPath(pointsSource, ClipperLib::ptSubject, true);
-        clipper.AddPath(clipArea, ClipperLib::ptClip, true);
+bool GisFileReader::clipPolygons(const std::vector<GAPoint> &clipArea,
+                                 const ClipProgress &progress) {
+    GisEnvelope clipEnvelope;
+    for (const GAPoint &point : clipArea) {
+        clipEnvelope.expand(point.x(), point.y());
+    }
 
-        ClipperLib::Paths clippedArea;
-        clipper.Execute(ClipperLib::ctIntersection, clippedArea);
+    // The grid covers the polygon too, its vertices may be far beyond the layer.
+    GisEnvelope gridEnvelope = entitiesEnvelope(entities_);
+    gridEnvelope.expand(clipEnvelope);
+    ClipperGrid grid = clipperGrid(gridEnvelope);
+    ClipperLib::Path clipAreaPath = pathFromPolygon(grid, clipArea);
+
+    auto clipTask = [&](std::size_t firstEntity, std::size_t endEntity, ClipTaskResult &result) {
+        ClipperAreaClipper areaClipper(grid, clipAreaPath, ClipperLib::pftNonZero);
+
+        for (std::size_t entityIndex = firstEntity; entityIndex < endEntity; ++entityIndex) {
+            const GisEntity &entity = entities_[entityIndex];
+            std::size_t resultsBegin = result.entities.size();
+
+            switch (envelopePosition(clipArea, clipEnvelope, entity.envelope())) {
+                case EnvelopeOutside:
+                    result.changes.push_back({entityIndex, 0, entity});
+                    break;
+                case EnvelopeInside:
+                    result.entities.push_back(entity);
+                    break;
+                case EnvelopeCrossing:
+                    areaClipper.clipPolygon(entity, result.geometry, result.entities);
+                    result.changes.push_back(
+                        {entityIndex, result.entities.size() - resultsBegin, entity});
+                    break;
+            }
+        }
+    };
 
-        for (auto &path : clippedArea) {
-            entities_.push_back(entity.cloneWithoutPoints());
-            fillEntityFromPath(entities_.back(), path);
+    return clipEntities(clipTask, progress);
+}
+
+bool GisFileReader::clipEntities(const ClipTask &clipTask, const ClipProgress &progress) {
+    // Entities of earlier clips may be in several stores, their points are counted one by one.
+    std::size_t layerPointsCount = 0;
+    for (const GisEntity &entity : entities_) {
+        layerPointsCount += entity.points().size();
+    }
+
+    // Tasks take consecutive entities with about the same number of points.
+    int threadsCount = gisThreadsCount(clipThreadsCount_);
+    // Extra tasks let progress advance in small steps with one thread too.
+    std::size_t pointsPerTask = std::max(
+        minPointsPerClipTask, layerPointsCount / (static_cast<std::size_t>(threadsCount) * 8 + 64));
+
+    std::vector<std::size_t> tasksFirstEntity;
+    std::size_t taskPoints = pointsPerTask;
+    for (std::size_t entityIndex = 0; entityIndex < entities_.size(); ++entityIndex) {
+        if (taskPoints >= pointsPerTask) {
+            tasksFirstEntity.push_back(entityIndex);
+            taskPoints = 0;
         }
+        taskPoints += entities_[entityIndex].points().size();
     }
+    tasksFirstEntity.push_back(entities_.size());
+
+    std::size_t tasksCount = tasksFirstEntity.size() - 1;
+    std::vector<ClipTaskResult> tasksResults(tasksCount);
+    std::atomic<std::size_t> entitiesDone(0);
+    std::atomic<bool> canceled(false);
+
+    gisParallelFor(tasksCount, threadsCount, [&](std::size_t iTaskNumber, int iThreadNumber) {
+        if (canceled) {
+            return;
+        }
+
+        ClipTaskResult &result = tasksResults[iTaskNumber];
+        clipTask(tasksFirstEntity[iTaskNumber], tasksFirstEntity[iTaskNumber + 1], result);
+        result.geometry.updateEnvelopes();
+
+        entitiesDone += tasksFirstEntity[iTaskNumber + 1] - tasksFirstEntity[iTaskNumber];
+        // Progress is reported only from the calling thread.
+        if (iThreadNumber == 0 && progress && !progress(entitiesDone, entities_.size())) {
+            canceled = true;
+        }
+    });
+
+    if (canceled) {
+        return false;
+    }
+
+    // Merge results in order of entities.
+    std::size_t entitiesCount = 0;
+    std::size_t changesCount = 0;
+    std::size_t geometryEntitiesCount = 0;
+    std::size_t pointsCount = 0;
+    for (const ClipTaskResult &result : tasksResults) {
+        entitiesCount += result.entities.size();
+        changesCount += result.changes.size();
+        geometryEntitiesCount += result.geometry.entitiesCount();
+        pointsCount += result.geometry.pointsCount();
+    }
+
+    std::vector<GisEntity> entities;
+    ClipLevel level;
+    level.entitiesCount = entities_.size();
+    level.geometry.reset(new GisGeometryStore);
+    entities.reserve(entitiesCount);
+    level.changes.reserve(changesCount);
+    level.geometry->reserve(geometryEntitiesCount, pointsCount);
+
+    for (ClipTaskResult &result : tasksResults) {
+        std::size_t firstGeometryIndex = level.geometry->append(result.geometry);
+
+        // Clipped entities move to the store of the level, kept ones stay where they are.
+        for (auto &entity : result.entities) {
+            if (entity.geometry() == &result.geometry) {
+                entity.setGeometry(level.geometry.get(),
+                                   firstGeometryIndex + entity.geometryIndex());
+            }
+            entities.push_back(std::move(entity));
+        }
+        level.changes.insert(level.changes.end(), result.changes.begin(), result.changes.end());
+
+        result = ClipTaskResult();
+    }
+
+    entities_.swap(entities);
+    clipHistory_.push_back(std::move(level));
+    isEntitiesTreeValid_ = false;
+
+    if (progress && clipHistory_.back().entitiesCount != 0) {
+        progress(clipHistory_.back().entitiesCount, clipHistory_.back().entitiesCount);
+    }
+
+    return true;
+}
+
+double GisFileReader::clipperResolution() const {
+    return 1 / clipperGrid(entitiesEnvelope(entities_)).scale;
+}
+
+GisFileReader::ClipMethod GisFileReader::clipMethod() const { return clipMethod_; }
+
+void GisFileReader::setClipMethod(ClipMethod clipMethod) { clipMethod_ = clipMethod; }
+
+int GisFileReader::clipThreadsCount() const { return clipThreadsCount_; }
+
+void GisFileReader::setClipThreadsCount(int clipThreadsCount) {
+    clipThreadsCount_ = clipThreadsCount;
 }
 
+std::size_t GisFileReader::clipLevelsCount() const { return clipHistory_.size(); }
+
 void GisFileReader::restorePolygons() {
-    if (entitiesClipBackup_.empty()) {
+    if (clipHistory_.empty()) {
         return;
     }
-    entities_.clear();
-    entities_.splice(entities_.begin(), entitiesClipBackup_);
+
+    const ClipLevel &level = clipHistory_.back();
+    std::vector<GisEntity> entities;
+    entities.reserve(level.entitiesCount);
+
+    // Runs of kept entities between changes are copied as they are.
+    auto keptBegin = entities_.begin();
+    for (const ClipChange &change : level.changes) {
+        auto keptEnd = keptBegin + (change.entityIndex - entities.size());
+        entities.insert(entities.end(), keptBegin, keptEnd);
+        entities.push_back(change.entity);
+        keptBegin = keptEnd + change.resultsCount;
+    }
+    entities.insert(entities.end(), keptBegin, entities_.end());
+
+    entities_.swap(entities);
+    clipHistory_.pop_back();
+    isEntitiesTreeValid_ = false;
+}
+
+const GisRTree &GisFileReader::entitiesTree() {
+    if (!isEntitiesTreeValid_) {
+        entitiesTree_.build(entities_, clipThreadsCount_);
+        isEntitiesTreeValid_ = true;
+    }
+
+    return entitiesTree_;
+}
+
+bool GisFileReader::entityAt(double x, double y, std::size_t &entityIndex) {
+    std::vector<std::size_t> candidates;
+    entitiesTree().queryPoint(x, y, candidates);
+
+    // The last entity is on top, it is tested first.
+    std::sort(candidates.begin(), candidates.end(), std::greater<std::size_t>());
+    for (std::size_t candidate : candidates) {
+        if (entities_[candidate].containsPoint(x, y)) {
+            entityIndex = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void GisFileReader::clearClipHistory() {
+    clipHistory_.clear();
+    entitiesTree_.clear();
+    isEntitiesTreeValid_ = false;
 }
@@ -5,11 +5,43 @@
   This file contains declaration of abstract class GisFileReader.
   */
 
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "gisattributetable.h"
+#include "giscoordinatesconverterinterface.h"
 #include "gisentity.h"
+#include "gisenvelope.h"
 #include "gisfield.h"
+#include "gisgeometrystore.h"
+#include "gisrtree.h"
 
 class GisFileReader {
    public:
+    /**
+     * @brief Function called by forEachEntity() for every entity.
+     * @details Entity and its points are valid only during the call.
+     * @return True - to continue reading. False - to stop.
+     */
+    using EntityVisitor = std::function<bool(const GisEntity&)>;
+
+    /**
+     * @brief Function called by clipPolygons() as entities are clipped.
+     * @details Called in the thread that called clipPolygons() with number of
+     * entities clipped so far and number of all entities.
+     * @return True - to continue clipping. False - to cancel it.
+     */
+    using ClipProgress = std::function<bool(std::size_t, std::size_t)>;
+
+    /**
+     * @brief Way of clipping entities crossing the boundary of the clip area.
+     */
+    enum ClipMethod {
+        ClipMethodRectangle,  ///< Rings are clipped on doubles by GisRectangleClipper.
+        ClipMethodClipper     ///< ClipperLib intersection splitting results into polygons.
+    };
+
     GisFileReader();
     GisFileReader(std::string filename);
     virtual ~GisFileReader();
@@ -26,6 +58,30 @@ class GisFileReader {
      */
     virtual bool readFile(const std::string& filename);
 
+    /**
+     * @brief Read file entity by entity without storing them in entities().
+     * @details Implementations reuse the same GisEntity and buffers for every
+     * entity, so memory doesn't grow with size of the file. Default
+     * implementation reads the whole file with readFile() and visits entities().
+     * @param visitor - function called for every entity.
+     * @return True - if file opened correctly. False - otherwise.
+     */
+    virtual bool forEachEntity(const EntityVisitor& visitor);
+
+    /**
+     * @brief Read only entities whose bounding box intersects given rectangle.
+     * @details Extents of the reader stay the extents of the whole file.
+     * Default implementation reads the whole file with readFile() and drops
+     * entities outside of the rectangle, readers with spatial indexes avoid
+     * reading them at all.
+     * @param minX - minimal X of the rectangle.
+     * @param minY - minimal Y of the rectangle.
+     * @param maxX - maximal X of the rectangle.
+     * @param maxY - maximal Y of the rectangle.
+     * @return True - if file opened correctly. False - otherwise.
+     */
+    virtual bool readFileInRect(double minX, double minY, double maxX, double maxY);
+
     /**
      * @brief Get maximal X of whole map file.
      * @return Maximal X of whole map file.
@@ -50,6 +106,12 @@ class GisFileReader {
      */
     double minY() const;
 
+    /**
+     * @brief Get extents of whole map file as one box.
+     * @return Envelope with minX(), minY(), maxX() and maxY().
+     */
+    GisEnvelope envelope() const;
+
     /**
      * @brief Get name of map file.
      * @return Filename of map file.
@@ -62,21 +124,271 @@ class GisFileReader {
      * entities.
      * @return List of GisEntity.
      */
-    const std::list<GisEntity>& entities() const;
+    const std::vector<GisEntity>& entities() const;
+
+    /**
+     * @brief Get columnar storage of the points of read entities.
+     * @details Entities clipped by clipPolygons() keep their points in stores
+     * of the clip history, entities() refers to both.
+     * @return Geometry store of the layer.
+     */
+    const GisGeometryStore& geometry() const;
+
+    /**
+     * @brief Get columnar storage of the fields of entities().
+     * @return Attribute table of the layer.
+     */
+    virtual const GisAttributeTable& attributes() const;
+
+    /**
+     * @brief Read only fields with given names, other fields are skipped.
+     * @details Fields keep the order of the file, unknown names are ignored.
+     * Empty list reads geometry only, files of attributes are not parsed then.
+     * Applies to the next read.
+     * @param fieldNames - names of the fields to read.
+     */
+    virtual void setFieldsProjection(const std::vector<std::string>& fieldNames);
+
+    /**
+     * @brief Read only fields with given indices in the file, other fields are
+     * skipped.
+     * @details Same as setFieldsProjection() but fields are chosen by position.
+     * @param fieldIndices - zero-based indices of the fields to read.
+     */
+    virtual void setFieldsProjectionByIndex(const std::vector<int>& fieldIndices);
+
+    /**
+     * @brief Read all fields of the file (default).
+     */
+    virtual void resetFieldsProjection();
+
+    bool hasFieldsProjection() const;
+
+    /**
+     * @brief Get converter of points applied while decoding.
+     * @return Converter or nullptr if points keep coordinates of the file.
+     */
+    GisCoordinatesConverterInterface* pointsConverter() const;
 
-    std::list<GisEntity>& entities();
+    /**
+     * @brief Convert points of every entity right after it is decoded.
+     * @details Points are converted in place in the geometry store, so the
+     * layer is kept in memory only once. Extents are computed from converted
+     * points then, readFileInRect() selects entities by the rectangle in
+     * coordinates of the file and gives extents of the selected ones. The
+     * converter may be called from several threads at once, it isn't owned
+     * by the reader. Applies to readFile() and readFileInRect().
+     * @param pointsConverter - converter or nullptr to keep coordinates of the
+     * file (default).
+     */
+    void setPointsConverter(GisCoordinatesConverterInterface* pointsConverter);
 
     int entitiesPointsCount() const;
 
-    void clipPolygons(double clipAreaLeft, double clipAreaTop, double clipAreaRight,
-                      double clipAreaBottom);
+    /**
+     * @brief Replace entities by their intersections with the rectangle, the
+     * previous ones are restored by restorePolygons().
+     * @details Entities are classified by their envelopes first: ones outside
+     * of the rectangle are dropped and ones inside are copied as they are,
+     * only entities crossing its boundary are clipped by clipMethod().
+     * Entities are clipped on clipThreadsCount() threads, the result keeps
+     * their order.
+     * @param progress - function to report progress to, may be empty.
+     * @return True - if entities were clipped. False - if progress canceled
+     * clipping, entities stay unchanged then.
+     */
+    bool clipPolygons(double clipAreaLeft, double clipAreaTop, double clipAreaRight,
+                      double clipAreaBottom, const ClipProgress& progress = ClipProgress());
+
+    /**
+     * @brief Replace entities by their intersections with the polygon, the
+     * previous ones are restored by restorePolygons().
+     * @details Entities are classified by their envelopes first: ones outside
+     * of the polygon are dropped and ones inside are copied as they are, only
+     * entities crossing its boundary are clipped, by Clipper whatever
+     * clipMethod() is. Every polygon of an intersection becomes an entity
+     * whose first part is the outer ring and the rest are its holes. Points
+     * wound around by a self-intersecting polygon are inside (non-zero rule).
+     * Entities are clipped on clipThreadsCount() threads, the result keeps
+     * their order. The Clipper grid covers the polygon too, so it is coarser
+     * than clipperResolution() if the polygon reaches beyond the layer.
+     * @param clipArea - vertices of the polygon, the last one is joined to the
+     * first one.
+     * @param progress - function to report progress to, may be empty.
+     * @return True - if entities were clipped. False - if progress canceled
+     * clipping, entities stay unchanged then.
+     */
+    bool clipPolygons(const std::vector<GAPoint>& clipArea,
+                      const ClipProgress& progress = ClipProgress());
+
+    ClipMethod clipMethod() const;
+
+    /**
+     * @brief Set way of clipping entities crossing the boundary of the clip area.
+     * @details ClipMethodRectangle (default) keeps exact coordinates and every
+     * clipped entity stays one entity with a part per ring, pieces of a ring
+     * are joined along the boundary. ClipMethodClipper rounds coordinates to
+     * the Clipper grid, see clipperResolution(), and gives an entity per
+     * resulting polygon with its holes.
+     */
+    void setClipMethod(ClipMethod clipMethod);
+
+    /**
+     * @brief Get step of the Clipper grid for the current entities.
+     * @details The grid is chosen per layer from its envelope, as fine as
+     * Clipper allows without falling back to 128-bit arithmetic.
+     * @return Distance between neighbouring coordinates of ClipMethodClipper
+     * results, in units of the layer.
+     */
+    double clipperResolution() const;
 
+    /**
+     * @brief Get number of threads that clip entities.
+     * @return Number of threads, 0 means number of hardware threads.
+     */
+    int clipThreadsCount() const;
+
+    /**
+     * @brief Set number of threads that clip entities in clipPolygons().
+     * @param clipThreadsCount - number of threads, 0 means number of hardware
+     * threads (default).
+     */
+    void setClipThreadsCount(int clipThreadsCount);
+
+    /**
+     * @brief Get number of clips restorePolygons() can step back from.
+     * @return Number of levels of the clip history.
+     */
+    std::size_t clipLevelsCount() const;
+
+    /**
+     * @brief Step back from the last clipPolygons() that wasn't undone yet.
+     * @details Every clip keeps only entities it dropped or clipped, kept
+     * entities share points and fields with the previous level. So stepping
+     * back restores only changed entities and copies handles of the rest.
+     * Does nothing if there are no clips to step back from.
+     */
     void restorePolygons();
 
+    /**
+     * @brief Get R-tree over envelopes of entities().
+     * @details The tree is built on clipThreadsCount() threads on the first
+     * call after entities change, items of the tree are indices in entities().
+     * @return Tree valid until entities change.
+     */
+    const GisRTree& entitiesTree();
+
+    /**
+     * @brief Find the entity the point is inside of.
+     * @details Candidates are found by their envelopes in entitiesTree(),
+     * then tested by GisEntity::containsPoint(). Entities are drawn in order,
+     * so of overlapping entities the last one is found.
+     * @param entityIndex - index of the found entity in entities().
+     * @return True - if an entity was found. False - otherwise.
+     */
+    bool entityAt(double x, double y, std::size_t& entityIndex);
+
    protected:
-    std::list<GisEntity> entities_;
-    std::list<GisEntity> entitiesClipBackup_;
+    /**
+     * @brief Select fields of the file that must be read.
+     * @param fieldNames - names of all fields of the file in their order.
+     * @return Indices of projected fields in order of the file.
+     */
+    std::vector<int> projectedFields(const std::vector<std::string>& fieldNames) const;
+
+    /**
+     * @brief Check whether projection excludes all fields.
+     * @return True - if no fields must be read. False - otherwise.
+     */
+    bool isGeometryOnly() const;
+
+    /**
+     * @brief Convert points of the entity in place with pointsConverter().
+     * @details Does nothing if no converter is set.
+     * @param geometry - store with the entity.
+     * @param geometryIndex - index of the entity inside of the store.
+     */
+    void convertEntityPoints(GisGeometryStore& geometry, std::size_t geometryIndex) const;
+
+    /**
+     * @brief Compute extents from envelopes of all entities.
+     * @details Envelopes missing in the geometry store are computed first.
+     * Extents are zeros if there are no points.
+     */
+    void fillLimitsFromGeometry();
+
+    /**
+     * @brief Move entities, their geometry and extents of the reader to this
+     * one, the reader is left without entities.
+     * @details Fields stay in the attribute table of the reader, entities keep
+     * pointing to it.
+     * @param reader - reader to take entities from.
+     */
+    void takeEntities(GisFileReader& reader);
+
+    /**
+     * @brief Entity replaced by a clip with its results.
+     */
+    struct ClipChange {
+        std::size_t entityIndex;   // index of the entity before the clip
+        std::size_t resultsCount;  // number of entities it became, 0 if it was dropped
+        GisEntity entity;
+    };
+
+    /**
+     * @brief Result of clipping of consecutive entities by one task.
+     */
+    struct ClipTaskResult {
+        GisGeometryStore geometry;        // points of clipped entities
+        std::vector<GisEntity> entities;  // kept and clipped entities in order
+        std::vector<ClipChange> changes;  // dropped and clipped entities in order
+    };
+
+    /**
+     * @brief Level of the clip history, enough to step back from the clip.
+     */
+    struct ClipLevel {
+        std::size_t entitiesCount;  // number of entities before the clip
+        std::vector<ClipChange> changes;
+        std::unique_ptr<GisGeometryStore> geometry;  // points of clipped entities
+    };
+
+    /**
+     * @brief Function that clips entities with indices from first to before
+     * last into the result of a task.
+     * @details Entities inside of the clip area are appended as they are and
+     * aren't changes.
+     */
+    using ClipTask = std::function<void(std::size_t, std::size_t, ClipTaskResult&)>;
+
+    /**
+     * @brief Run clipTask over consecutive ranges of entities on
+     * clipThreadsCount() threads and replace entities by the results in order,
+     * the changes are pushed to the clip history for restorePolygons().
+     * @return True - if entities were clipped. False - if progress canceled
+     * clipping, entities stay unchanged then.
+     */
+    bool clipEntities(const ClipTask& clipTask, const ClipProgress& progress);
+
+    /**
+     * @brief Forget all clips and the tree of entities, must be called before
+     * entities are replaced by other means.
+     */
+    void clearClipHistory();
+
+    std::vector<GisEntity> entities_;
+    std::unique_ptr<GisGeometryStore> geometry_;
+    std::unique_ptr<GisAttributeTable> attributes_;
+    std::vector<ClipLevel> clipHistory_;
+    GisRTree entitiesTree_;
     std::string filename_;
+    bool fieldsProjection_;
+    std::vector<std::string> projectedFieldNames_;
+    std::vector<int> projectedFieldIndices_;
+    GisCoordinatesConverterInterface* pointsConverter_;
+    ClipMethod clipMethod_;
+    int clipThreadsCount_;
+    bool isEntitiesTreeValid_;
     double maxX_;
     double minX_;
     double maxY_;
@@ -1,11 +1,34 @@
 #include "gisfilereaderconvertdecorator.h"
 
+#include "gisparallel.h"
+
+#include <algorithm>
+
+namespace {
+
+// Minimal number of points converted by one parallel task.
+const std::size_t minPointsPerTask = 16 * 1024;
+
+/**
+ * @brief Part of an entity of the wrapped reader and place of its converted
+ * points in the geometry store of the decorator.
+ */
+struct ConvertedPart {
+    GisPointsSpan source;
+    std::size_t first;
+};
+
+} // namespace
+
 GisFileReaderConvertDecorator::GisFileReaderConvertDecorator()
-    : gisFileReader_(nullptr), coordinatesConverter_(nullptr) {}
+    : gisFileReader_(nullptr), coordinatesConverter_(nullptr), threadsCount_(0), fused_(false) {}
 
 GisFileReaderConvertDecorator::GisFileReaderConvertDecorator(
     GisFileReader *gisFileReader, GisCoordinatesConverterInterface *coordinatesConverter)
-    : gisFileReader_(gisFileReader), coordinatesConverter_(coordinatesConverter) {}
+    : gisFileReader_(gisFileReader),
+      coordinatesConverter_(coordinatesConverter),
+      threadsCount_(0),
+      fused_(false) {}
 
 GisFileReaderConvertDecorator::~GisFileReaderConvertDecorator() {
 
@@ -19,13 +42,31 @@ bool GisFileReaderConvertDecorator::readFile() {
         return false;
     }
 
+    if (fused_) {
+        return readFused();
+    }
+
+    clearEntities();
     bool openFileResult = gisFileReader_->readFile();
 
     if (!openFileResult) {
         return false;
     }
 
-    entities_.clear();
+    return reproject();
+}
+
+bool GisFileReaderConvertDecorator::reproject() {
+    if (!gisFileReader_ || !coordinatesConverter_) {
+        return false;
+    }
+
+    if (fused_) {
+        return readFused();
+    }
+
+    // Clipped entities are in the old projection, the whole layer is shown again.
+    clearEntities();
     fillDecoratorEntities();
 
     return true;
@@ -36,37 +77,140 @@ bool GisFileReaderConvertDecorator::readFile(const std::string &filename) {
     return readFile();
 }
 
-void GisFileReaderConvertDecorator::fillDecoratorEntities() {
-    std::set<double> xValues;
-    std::set<double> yValues;
+bool GisFileReaderConvertDecorator::forEachEntity(const EntityVisitor &visitor) {
+    if (!gisFileReader_ || !coordinatesConverter_) {
+        return false;
+    }
 
-    for (const auto &entityIter : gisFileReader_->entities()) {
-        entities_.emplace_back();
+    // The same store and entity are reused for every entity.
+    GisGeometryStore geometry;
+    GisEntity entityConverted;
+
+    return gisFileReader_->forEachEntity([&](const GisEntity &entity) {
+        geometry.clear();
+        entityConverted.setGeometry(&geometry, geometry.beginEntity());
+
+        for (std::size_t partIndex = 0; partIndex < entity.partsCount(); ++partIndex) {
+            appendConvertedPart(geometry, entity.part(partIndex));
+        }
+        geometry.updateEnvelopes();
+
+        entityConverted.setAttributes(entity.attributes(), entity.attributesRow());
+
+        return visitor(entityConverted);
+    });
+}
+
+bool GisFileReaderConvertDecorator::readFused() {
+    clearEntities();
+
+    // The converter is owned by the decorator, the wrapped reader uses it only while reading.
+    gisFileReader_->setPointsConverter(coordinatesConverter_);
+    bool openFileResult = gisFileReader_->readFile();
+    gisFileReader_->setPointsConverter(nullptr);
+
+    if (!openFileResult) {
+        return false;
+    }
+
+    // Fields stay in the wrapped reader, see attributes().
+    takeEntities(*gisFileReader_);
 
-        for (const auto &pointsIter : entityIter.points()) {
-            GAPoint pointConverted = coordinatesConverter_->transformCoordinate(pointsIter);
+    return true;
+}
 
-            entities_.back().addPoint(pointConverted);
+void GisFileReaderConvertDecorator::clearEntities() {
+    clearClipHistory();
+    entities_.clear();
+    geometry_->clear();
+}
+
+void GisFileReaderConvertDecorator::fillDecoratorEntities() {
+    const std::vector<GisEntity> &sourceEntities = gisFileReader_->entities();
 
-            xValues.insert(pointConverted.x());
-            yValues.insert(pointConverted.y());
+    entities_.reserve(sourceEntities.size());
+    geometry_->reserve(sourceEntities.size(), gisFileReader_->entitiesPointsCount());
+
+    // Layout of the store is built first, points are converted in parallel then.
+    std::vector<ConvertedPart> parts;
+    for (const auto &entityIter : sourceEntities) {
+        entities_.emplace_back();
+        entities_.back().setGeometry(geometry_.get(), geometry_->beginEntity());
+
+        for (std::size_t partIndex = 0; partIndex < entityIter.partsCount(); ++partIndex) {
+            GisPointsSpan part = entityIter.part(partIndex);
+            geometry_->beginPart();
+            parts.push_back({part, geometry_->appendPoints(part.size())});
         }
 
-        for (const auto &fieldsIter : entityIter.fields()) {
-            entities_.back().addField(fieldsIter);
+        // Fields are shared with the wrapped reader instead of being copied.
+        entities_.back().setAttributes(entityIter.attributes(), entityIter.attributesRow());
+    }
+
+    // Tasks take consecutive parts with about the same number of points.
+    int threadsCount = gisThreadsCount(threadsCount_);
+    std::size_t pointsPerTask = std::max(
+        minPointsPerTask, geometry_->pointsCount() / (static_cast<std::size_t>(threadsCount) * 8));
+
+    std::vector<std::size_t> tasksFirstPart;
+    std::size_t taskPoints = pointsPerTask;
+    for (std::size_t partIndex = 0; partIndex < parts.size(); ++partIndex) {
+        if (taskPoints >= pointsPerTask) {
+            tasksFirstPart.push_back(partIndex);
+            taskPoints = 0;
         }
+        taskPoints += parts[partIndex].source.size();
     }
+    tasksFirstPart.push_back(parts.size());
+
+    std::size_t tasksCount = tasksFirstPart.size() - 1;
+    double *x = geometry_->xData();
+    double *y = geometry_->yData();
+
+    gisParallelFor(tasksCount, threadsCount, [&](std::size_t iTaskNumber, int) {
+        for (std::size_t partIndex = tasksFirstPart[iTaskNumber];
+             partIndex < tasksFirstPart[iTaskNumber + 1]; ++partIndex) {
+            const ConvertedPart &part = parts[partIndex];
+            coordinatesConverter_->transformCoordinates(part.source.x(), part.source.y(),
+                                                        x + part.first, y + part.first,
+                                                        part.source.size());
+        }
+    });
 
-    minX_ = *xValues.begin();
-    maxX_ = *xValues.rbegin();
-    minY_ = *yValues.begin();
-    maxY_ = *yValues.rbegin();
+    // Extents are the union of envelopes of converted entities.
+    fillLimitsFromGeometry();
+}
+
+std::size_t GisFileReaderConvertDecorator::appendConvertedPart(GisGeometryStore &geometry,
+                                                              const GisPointsSpan &part) {
+    geometry.beginPart();
+
+    // The whole part is converted in one call straight into the store.
+    std::size_t first = geometry.appendPoints(part.size());
+    coordinatesConverter_->transformCoordinates(part.x(), part.y(), geometry.xData() + first,
+                                                geometry.yData() + first, part.size());
+
+    return first;
+}
+
+const GisAttributeTable &GisFileReaderConvertDecorator::attributes() const {
+    return gisFileReader_ ? gisFileReader_->attributes() : *attributes_;
 }
 
 GisFileReader *GisFileReaderConvertDecorator::gisFileReader() { return gisFileReader_; }
 
-void GisFileReaderConvertDecorator::setGisFileReader(GisFileReader *gisFileReader) {
+int GisFileReaderConvertDecorator::threadsCount() const { return threadsCount_; }
+
+void GisFileReaderConvertDecorator::setThreadsCount(int threadsCount) {
+    threadsCount_ = threadsCount;
+}
+
+bool GisFileReaderConvertDecorator::fused() const { return fused_; }
 
+void GisFileReaderConvertDecorator::setFused(bool fused) { fused_ = fused; }
+
+void GisFileReaderConvertDecorator::setGisFileReader(GisFileReader *gisFileReader) {
+    clearEntities();
     delete gisFileReader_;
 
     gisFileReader_ = gisFileReader;
@@ -77,6 +221,23 @@ void GisFileReaderConvertDecorator::setFilename(const std::string &filename) {
     gisFileReader_->setFilename(filename);
 }
 
+void GisFileReaderConvertDecorator::setFieldsProjection(
+    const std::vector<std::string> &fieldNames) {
+    GisFileReader::setFieldsProjection(fieldNames);
+    gisFileReader_->setFieldsProjection(fieldNames);
+}
+
+void GisFileReaderConvertDecorator::setFieldsProjectionByIndex(
+    const std::vector<int> &fieldIndices) {
+    GisFileReader::setFieldsProjectionByIndex(fieldIndices);
+    gisFileReader_->setFieldsProjectionByIndex(fieldIndices);
+}
+
+void GisFileReaderConvertDecorator::resetFieldsProjection() {
+    GisFileReader::resetFieldsProjection();
+    gisFileReader_->resetFieldsProjection();
+}
+
 GisCoordinatesConverterInterface *GisFileReaderConvertDecorator::coordinatesConverter() {
     return coordinatesConverter_;
 }
@@ -1,7 +1,5 @@
 #pragma once
 
-#include <set>
-
 #include "giscoordinatesconverterinterface.h"
 #include "gisfilereader.h"
 
@@ -16,17 +14,105 @@ class GisFileReaderConvertDecorator : public GisFileReader {
     virtual bool readFile();
     virtual bool readFile(const std::string& filename);
 
+    /**
+     * @brief Convert entities of the wrapped reader again with the current
+     * converter without reading the file.
+     * @details Entities of the wrapped reader keep the source coordinates, so
+     * changing the converter (e.g. map center) needs only this call. Points
+     * are converted in parallel, clipping is reset. In fused mode source
+     * coordinates aren't kept and the file is read again.
+     * @return True - if the wrapped reader and the converter are set. False - otherwise.
+     */
+    bool reproject();
+
+    /**
+     * @brief Check whether the wrapped reader converts points while decoding.
+     * @return True - if fused mode is on. False - otherwise (default).
+     */
+    bool fused() const;
+
+    /**
+     * @brief Let the wrapped reader convert points while decoding and take its
+     * entities instead of keeping a converted copy.
+     * @details The layer is kept in memory once, but entities of the wrapped
+     * reader are empty after reading and reproject() reads the file again.
+     * Applies to the next read.
+     * @param fused - true to convert while decoding.
+     */
+    void setFused(bool fused);
+
+    /**
+     * @brief Stream entities of the wrapped reader converting their points.
+     * @param visitor - function called for every converted entity.
+     * @return True - if file opened correctly. False - otherwise.
+     */
+    virtual bool forEachEntity(const EntityVisitor& visitor);
+
+    /**
+     * @brief Get fields of entities, they are shared with the wrapped reader.
+     * @return Attribute table of the wrapped reader.
+     */
+    virtual const GisAttributeTable& attributes() const;
+
     GisCoordinatesConverterInterface* coordinatesConverter();
     void setCoordinatesConverter(GisCoordinatesConverterInterface* coordinatesConverter);
 
     GisFileReader* gisFileReader();
     void setGisFileReader(GisFileReader* gisFileReader);
 
+    /**
+     * @brief Get number of threads that convert points.
+     * @return Number of threads, 0 means number of hardware threads.
+     */
+    int threadsCount() const;
+
+    /**
+     * @brief Set number of threads that convert points in readFile() and
+     * reproject().
+     * @details Converter is called from all threads at once, so it must not
+     * change its state in transformCoordinates(). Default 0 uses all hardware
+     * threads.
+     * @param threadsCount - number of threads, 0 means number of hardware threads.
+     */
+    void setThreadsCount(int threadsCount);
+
     virtual void setFilename(const std::string& filename);
 
+    /**
+     * @brief Projection is applied by the wrapped reader, it is passed to it.
+     */
+    virtual void setFieldsProjection(const std::vector<std::string>& fieldNames);
+    virtual void setFieldsProjectionByIndex(const std::vector<int>& fieldIndices);
+    virtual void resetFieldsProjection();
+
    private:
     void fillDecoratorEntities();
 
+    /**
+     * @brief Drop entities of the decorator together with their clips.
+     * @details Entities refer to fields in the table of the wrapped reader, so
+     * they are dropped before the reader reads again or is deleted.
+     */
+    void clearEntities();
+
+    /**
+     * @brief Read the file with the wrapped reader converting points and take
+     * its entities.
+     * @return True - if file opened correctly. False - otherwise.
+     */
+    bool readFused();
+
+    /**
+     * @brief Append converted points of the part as a new part of the entity
+     * being filled in geometry.
+     * @param geometry - store to append to.
+     * @param part - source points.
+     * @return Index of the first appended point in the store.
+     */
+    std::size_t appendConvertedPart(GisGeometryStore& geometry, const GisPointsSpan& part);
+
     GisFileReader* gisFileReader_;
     GisCoordinatesConverterInterface* coordinatesConverter_;
+    int threadsCount_;
+    bool fused_;
 };
@@ -0,0 +1,153 @@
+#include "gisgeometrystore.h"
+
+GisGeometryStore::GisGeometryStore() = default;
+
+void GisGeometryStore::clear() {
+    x_.clear();
+    y_.clear();
+    entityPoints_.clear();
+    entityParts_.clear();
+    partPoints_.clear();
+    envelopes_.clear();
+    envelope_ = GisEnvelope();
+}
+
+void GisGeometryStore::reserve(std::size_t entitiesCount, std::size_t pointsCount) {
+    x_.reserve(pointsCount);
+    y_.reserve(pointsCount);
+    entityPoints_.reserve(entitiesCount);
+    entityParts_.reserve(entitiesCount);
+    partPoints_.reserve(entitiesCount);
+    envelopes_.reserve(entitiesCount);
+}
+
+std::size_t GisGeometryStore::beginEntity() {
+    entityPoints_.push_back(x_.size());
+    entityParts_.push_back(partPoints_.size());
+    partPoints_.push_back(x_.size());
+
+    return entityPoints_.size() - 1;
+}
+
+void GisGeometryStore::beginPart() {
+    // Empty parts are not stored, the vertices will be appended to the current one.
+    if (partPoints_.back() != x_.size()) {
+        partPoints_.push_back(x_.size());
+    }
+}
+
+void GisGeometryStore::addPoint(double x, double y) {
+    x_.push_back(x);
+    y_.push_back(y);
+}
+
+void GisGeometryStore::addPoint(const GAPoint &point) { addPoint(point.x(), point.y()); }
+
+void GisGeometryStore::addPoints(const double *x, const double *y, std::size_t count) {
+    x_.insert(x_.end(), x, x + count);
+    y_.insert(y_.end(), y, y + count);
+}
+
+std::size_t GisGeometryStore::appendPoints(std::size_t count) {
+    std::size_t first = x_.size();
+    x_.resize(first + count);
+    y_.resize(first + count);
+
+    return first;
+}
+
+double *GisGeometryStore::xData() { return x_.data(); }
+
+double *GisGeometryStore::yData() { return y_.data(); }
+
+std::size_t GisGeometryStore::append(const GisGeometryStore &other) {
+    std::size_t firstEntity = entityPoints_.size();
+
+    // Otherwise updateEnvelopes() computes envelopes of appended entities.
+    if (hasEnvelopes() && other.hasEnvelopes()) {
+        envelopes_.insert(envelopes_.end(), other.envelopes_.begin(), other.envelopes_.end());
+        envelope_.expand(other.envelope_);
+    }
+
+    std::size_t pointsShift = x_.size();
+    std::size_t partsShift = partPoints_.size();
+
+    x_.insert(x_.end(), other.x_.begin(), other.x_.end());
+    y_.insert(y_.end(), other.y_.begin(), other.y_.end());
+
+    for (std::size_t pointIndex : other.entityPoints_) {
+        entityPoints_.push_back(pointIndex + pointsShift);
+    }
+    for (std::size_t partIndex : other.entityParts_) {
+        entityParts_.push_back(partIndex + partsShift);
+    }
+    for (std::size_t pointIndex : other.partPoints_) {
+        partPoints_.push_back(pointIndex + pointsShift);
+    }
+
+    return firstEntity;
+}
+
+std::size_t GisGeometryStore::entitiesCount() const { return entityPoints_.size(); }
+
+std::size_t GisGeometryStore::pointsCount() const { return x_.size(); }
+
+void GisGeometryStore::updateEnvelopes() {
+    for (std::size_t entityIndex = envelopes_.size(); entityIndex < entityPoints_.size();
+         ++entityIndex) {
+        GisPointsSpan entityPoints = points(entityIndex);
+        envelopes_.push_back(gisPointsEnvelope(entityPoints.x(), entityPoints.y(),
+                                               entityPoints.size()));
+        envelope_.expand(envelopes_.back());
+    }
+}
+
+bool GisGeometryStore::hasEnvelopes() const { return envelopes_.size() == entityPoints_.size(); }
+
+const GisEnvelope &GisGeometryStore::envelope(std::size_t entityIndex) const {
+    return envelopes_[entityIndex];
+}
+
+const GisEnvelope &GisGeometryStore::envelope() const { return envelope_; }
+
+GisPointsSpan GisGeometryStore::points(std::size_t entityIndex) const {
+    std::size_t begin = pointsBegin(entityIndex);
+    return {x_.data() + begin, y_.data() + begin, pointsEnd(entityIndex) - begin};
+}
+
+std::size_t GisGeometryStore::partsCount(std::size_t entityIndex) const {
+    return partsEnd(entityIndex) - partsBegin(entityIndex);
+}
+
+GisPointsSpan GisGeometryStore::part(std::size_t entityIndex, std::size_t partIndex) const {
+    std::size_t partNumber = partsBegin(entityIndex) + partIndex;
+    std::size_t begin = partPoints_[partNumber];
+    std::size_t end = partNumber + 1 < partsEnd(entityIndex) ? partPoints_[partNumber + 1]
+                                                             : pointsEnd(entityIndex);
+
+    return {x_.data() + begin, y_.data() + begin, end - begin};
+}
+
+std::size_t GisGeometryStore::memoryUsage() const {
+    return (x_.capacity() + y_.capacity()) * sizeof(double) +
+           (entityPoints_.capacity() + entityParts_.capacity() + partPoints_.capacity()) *
+               sizeof(std::size_t) +
+           envelopes_.capacity() * sizeof(GisEnvelope);
+}
+
+std::size_t GisGeometryStore::pointsBegin(std::size_t entityIndex) const {
+    return entityPoints_[entityIndex];
+}
+
+std::size_t GisGeometryStore::pointsEnd(std::size_t entityIndex) const {
+    return entityIndex + 1 < entityPoints_.size() ? entityPoints_[entityIndex + 1] : x_.size();
+}
+
+std::size_t GisGeometryStore::partsBegin(std::size_t entityIndex) const {
+    return entityParts_[entityIndex];
+}
+
+std::size_t GisGeometryStore::partsEnd(std::size_t entityIndex) const {
+    return entityIndex + 1 < entityParts_.size() ? entityParts_[entityIndex + 1]
+                                                 : partPoints_.size();
+}
@@ -0,0 +1,255 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of classes GisPointsSpan and GisGeometryStore.
+  */
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "gapoint.h"
+#include "gisenvelope.h"
+
+/**
+ * @brief Non-owning view of a contiguous run of vertices.
+ * @details Coordinates are kept in two separate arrays (structure of arrays),
+ * iteration yields GAPoint values built on the fly.
+ */
+class GisPointsSpan {
+   public:
+    class const_iterator {
+       public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = GAPoint;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = GAPoint;
+
+        const_iterator() : x_(nullptr), y_(nullptr) {}
+        const_iterator(const double* x, const double* y) : x_(x), y_(y) {}
+
+        GAPoint operator*() const { return {*x_, *y_}; }
+        GAPoint operator[](difference_type offset) const { return {x_[offset], y_[offset]}; }
+
+        const_iterator& operator++() {
+            ++x_;
+            ++y_;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        const_iterator& operator--() {
+            --x_;
+            --y_;
+            return *this;
+        }
+        const_iterator operator--(int) {
+            const_iterator previous = *this;
+            --*this;
+            return previous;
+        }
+        const_iterator& operator+=(difference_type offset) {
+            x_ += offset;
+            y_ += offset;
+            return *this;
+        }
+        const_iterator& operator-=(difference_type offset) { return *this += -offset; }
+        const_iterator operator+(difference_type offset) const {
+            return {x_ + offset, y_ + offset};
+        }
+        const_iterator operator-(difference_type offset) const {
+            return {x_ - offset, y_ - offset};
+        }
+        difference_type operator-(const const_iterator& other) const { return x_ - other.x_; }
+
+        bool operator==(const const_iterator& other) const { return x_ == other.x_; }
+        bool operator!=(const const_iterator& other) const { return x_ != other.x_; }
+        bool operator<(const const_iterator& other) const { return x_ < other.x_; }
+
+       private:
+        const double* x_;
+        const double* y_;
+    };
+
+    GisPointsSpan() : x_(nullptr), y_(nullptr), size_(0) {}
+    GisPointsSpan(const double* x, const double* y, std::size_t size)
+        : x_(x), y_(y), size_(size) {}
+
+    /**
+     * @brief Get pointer to the first x coordinate of the span.
+     * @return Pointer to contiguous array of size() x coordinates.
+     */
+    const double* x() const { return x_; }
+
+    /**
+     * @brief Get pointer to the first y coordinate of the span.
+     * @return Pointer to contiguous array of size() y coordinates.
+     */
+    const double* y() const { return y_; }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    GAPoint operator[](std::size_t index) const { return {x_[index], y_[index]}; }
+    GAPoint front() const { return (*this)[0]; }
+    GAPoint back() const { return (*this)[size_ - 1]; }
+
+    const_iterator begin() const { return {x_, y_}; }
+    const_iterator end() const { return {x_ + size_, y_ + size_}; }
+
+   private:
+    const double* x_;
+    const double* y_;
+    std::size_t size_;
+};
+
+/**
+ * @brief Columnar storage of the geometry of all entities of a layer.
+ * @details Vertices of every entity are appended to two contiguous arrays of x
+ * and y coordinates. Entities and their parts (rings) are described by arrays
+ * of offsets into these arrays, so no allocation per vertex takes place.\n
+ * Usage: call beginEntity(), optionally beginPart() for every part after the
+ * first one, and addPoint() for every vertex. Envelopes of entities are kept
+ * alongside, updateEnvelopes() computes them for entities added since its
+ * last call.
+ */
+class GisGeometryStore {
+   public:
+    GisGeometryStore();
+
+    /**
+     * @brief Remove all entities, keeping allocated capacity.
+     */
+    void clear();
+
+    /**
+     * @brief Preallocate memory for given number of entities and vertices.
+     * @param entitiesCount - expected number of entities.
+     * @param pointsCount - expected number of vertices of all entities.
+     */
+    void reserve(std::size_t entitiesCount, std::size_t pointsCount);
+
+    /**
+     * @brief Start a new entity with a single empty part.
+     * @return Index of the new entity.
+     */
+    std::size_t beginEntity();
+
+    /**
+     * @brief Start a new part of the last entity.
+     * @details Does nothing if current part of the entity is still empty.
+     */
+    void beginPart();
+
+    /**
+     * @brief Append vertex to the last part of the last entity.
+     * @param x - x coordinate of the vertex.
+     * @param y - y coordinate of the vertex.
+     */
+    void addPoint(double x, double y);
+    void addPoint(const GAPoint& point);
+
+    /**
+     * @brief Append count vertices to the last part of the last entity.
+     * @param x - array of x coordinates.
+     * @param y - array of y coordinates.
+     * @param count - number of vertices to append.
+     */
+    void addPoints(const double* x, const double* y, std::size_t count);
+
+    /**
+     * @brief Append count zero vertices to the last part of the last entity.
+     * @details Lets decoders write coordinates straight into the store through
+     * xData() and yData() without intermediate buffers.
+     * @param count - number of vertices to append.
+     * @return Index of the first appended vertex.
+     */
+    std::size_t appendPoints(std::size_t count);
+
+    /**
+     * @brief Get writable arrays of coordinates of all vertices of the store.
+     * @return Pointer to pointsCount() coordinates.
+     */
+    double* xData();
+    double* yData();
+
+    /**
+     * @brief Append all entities of other store after entities of this one.
+     * @details Envelopes are copied if both stores have them for all entities.
+     * @param other - store to copy entities from.
+     * @return Index of the first appended entity.
+     */
+    std::size_t append(const GisGeometryStore& other);
+
+    std::size_t entitiesCount() const;
+    std::size_t pointsCount() const;
+
+    /**
+     * @brief Compute envelopes of entities that don't have them yet.
+     * @details Readers call it once after storing points of a decoded range
+     * of entities or of a whole layer. Points must not change after their
+     * envelope is computed.
+     */
+    void updateEnvelopes();
+
+    /**
+     * @brief Check whether all entities have envelopes.
+     * @return True - if envelope() can be called for every entity. False - otherwise.
+     */
+    bool hasEnvelopes() const;
+
+    /**
+     * @brief Get envelope of the entity computed by updateEnvelopes().
+     * @param entityIndex - index of the entity returned by beginEntity().
+     * @return Bounding box of all vertices of the entity.
+     */
+    const GisEnvelope& envelope(std::size_t entityIndex) const;
+
+    /**
+     * @brief Get envelope of all entities that have envelopes.
+     * @return Bounding box of the layer, empty if there are no points.
+     */
+    const GisEnvelope& envelope() const;
+
+    /**
+     * @brief Get all vertices of the entity regardless of its parts.
+     * @param entityIndex - index of the entity returned by beginEntity().
+     * @return View of the vertices.
+     */
+    GisPointsSpan points(std::size_t entityIndex) const;
+
+    std::size_t partsCount(std::size_t entityIndex) const;
+
+    /**
+     * @brief Get vertices of one part (ring) of the entity.
+     * @param entityIndex - index of the entity returned by beginEntity().
+     * @param partIndex - index of the part inside of the entity.
+     * @return View of the vertices.
+     */
+    GisPointsSpan part(std::size_t entityIndex, std::size_t partIndex) const;
+
+    /**
+     * @brief Get number of bytes occupied by the store.
+     * @return Size of allocated arrays in bytes.
+     */
+    std::size_t memoryUsage() const;
+
+   private:
+    std::size_t pointsBegin(std::size_t entityIndex) const;
+    std::size_t pointsEnd(std::size_t entityIndex) const;
+    std::size_t partsBegin(std::size_t entityIndex) const;
+    std::size_t partsEnd(std::size_t entityIndex) const;
+
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<std::size_t> entityPoints_;  // index of the first vertex of every entity
+    std::vector<std::size_t> entityParts_;   // index of the first part of every entity
+    std::vector<std::size_t> partPoints_;    // index of the first vertex of every part
+    std::vector<GisEnvelope> envelopes_;     // envelopes of the first entities
+    GisEnvelope envelope_;                   // union of envelopes_
+};
@@ -0,0 +1,117 @@
+#include "gismappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+GisMappedFile::GisMappedFile()
+    : data_(nullptr), size_(0), fileHandle_(INVALID_HANDLE_VALUE), mappingHandle_(nullptr) {}
+
+bool GisMappedFile::open(const std::string &filename) {
+    close();
+
+    fileHandle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle_ == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle_, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    mappingHandle_ = CreateFileMappingA(fileHandle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle_) {
+        close();
+        return false;
+    }
+
+    data_ = static_cast<const unsigned char *>(
+        MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        close();
+        return false;
+    }
+    size_ = static_cast<std::size_t>(fileSize.QuadPart);
+
+    return true;
+}
+
+void GisMappedFile::close() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mappingHandle_) {
+        CloseHandle(mappingHandle_);
+    }
+    if (fileHandle_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    mappingHandle_ = nullptr;
+    fileHandle_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+GisMappedFile::GisMappedFile() : data_(nullptr), size_(0) {}
+
+bool GisMappedFile::open(const std::string &filename) {
+    close();
+
+    int fileDescriptor = ::open(filename.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+        ::close(fileDescriptor);
+        return false;
+    }
+
+    void *mapped = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ,
+                        MAP_PRIVATE, fileDescriptor, 0);
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fileDescriptor);
+
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    // Records are decoded front to back.
+    madvise(mapped, static_cast<std::size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+    data_ = static_cast<const unsigned char *>(mapped);
+    size_ = static_cast<std::size_t>(fileStat.st_size);
+
+    return true;
+}
+
+void GisMappedFile::close() {
+    if (data_) {
+        munmap(const_cast<unsigned char *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+GisMappedFile::~GisMappedFile() { close(); }
+
+bool GisMappedFile::isOpen() const { return data_ != nullptr; }
+
+const unsigned char *GisMappedFile::data() const { return data_; }
+
+std::size_t GisMappedFile::size() const { return size_; }
@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisMappedFile.
+  */
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+class GisMappedFile {
+   public:
+    GisMappedFile();
+    ~GisMappedFile();
+
+    GisMappedFile(const GisMappedFile&) = delete;
+    GisMappedFile& operator=(const GisMappedFile&) = delete;
+
+    /**
+     * @brief Map file into memory, previously mapped file is closed.
+     * @param filename - name of the file to map.
+     * @return True - if file was mapped successfully. False - otherwise.
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * @brief Unmap the file.
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * @brief Get pointer to the first byte of the file.
+     * @return Pointer to mapped memory or nullptr if file is not mapped.
+     */
+    const unsigned char* data() const;
+
+    /**
+     * @brief Get size of the mapped file.
+     * @return Size in bytes.
+     */
+    std::size_t size() const;
+
+   private:
+    const unsigned char* data_;
+    std::size_t size_;
+#ifdef _WIN32
+    void* fileHandle_;
+    void* mappingHandle_;
+#endif
+};
@@ -0,0 +1,64 @@
+#include "gisparallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int gisThreadsCount(int threadsCount) {
+    if (threadsCount <= 0) {
+        threadsCount = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    return std::max(threadsCount, 1);
+}
+
+void gisParallelFor(std::size_t tasksCount, int threadsCount,
+                    const std::function<void(std::size_t, int)>& task) {
+    threadsCount = static_cast<int>(
+        std::min<std::size_t>(gisThreadsCount(threadsCount), std::max<std::size_t>(tasksCount, 1)));
+
+    if (threadsCount == 1) {
+        for (std::size_t taskIndex = 0; taskIndex < tasksCount; ++taskIndex) {
+            task(taskIndex, 0);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> nextTask(0);
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+
+    auto worker = [&](int threadIndex) {
+        for (std::size_t taskIndex = nextTask++; taskIndex < tasksCount;
+             taskIndex = nextTask++) {
+            try {
+                task(taskIndex, threadIndex);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!exception) {
+                    exception = std::current_exception();
+                }
+                // Skip the rest of the tasks.
+                nextTask = tasksCount;
+            }
+        }
+    };
+
+    // The calling thread works too.
+    std::vector<std::thread> threads;
+    threads.reserve(threadsCount - 1);
+    for (int threadIndex = 1; threadIndex < threadsCount; ++threadIndex) {
+        threads.emplace_back(worker, threadIndex);
+    }
+    worker(0);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
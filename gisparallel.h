@@ -0,0 +1,30 @@
+#pragma once
+
+/**
+  @file
+  This file contains functions that run independent tasks on several threads.
+  */
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * @brief Get number of threads to run for requested value.
+ * @param threadsCount - requested number of threads, 0 or less means number of
+ * hardware threads.
+ * @return Number of threads, at least 1.
+ */
+int gisThreadsCount(int threadsCount);
+
+/**
+ * @brief Run tasksCount independent tasks on threadsCount threads.
+ * @details Threads take tasks in increasing order of index. With one thread
+ * all tasks are run in order in the calling thread. The first exception thrown
+ * by a task is rethrown after all threads have finished.
+ * @param tasksCount - number of tasks.
+ * @param threadsCount - number of threads, see gisThreadsCount().
+ * @param task - function called with index of the task and index of the thread
+ * in range [0, threadsCount) that runs it.
+ */
+void gisParallelFor(std::size_t tasksCount, int threadsCount,
+                    const std::function<void(std::size_t, int)>& task);
@@ -0,0 +1,365 @@
+#include "gisrectangleclipper.h"
+
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief Twice the signed area of the ring, positive if it goes counter-clockwise.
+ */
+double ringDoubleArea(const std::vector<double> &x, const std::vector<double> &y) {
+    double doubleArea = 0;
+    for (std::size_t i = 0, previous = x.size() - 1; i < x.size(); previous = i++) {
+        doubleArea += x[previous] * y[i] - x[i] * y[previous];
+    }
+
+    return doubleArea;
+}
+
+} // namespace
+
+GisRectangleClipper::GisRectangleClipper(const GisEnvelope &rectangle) : rectangle_(rectangle) {}
+
+bool GisRectangleClipper::clipPolygon(const GisEntity &entity, GisGeometryStore &geometry,
+                                      std::size_t &geometryIndex) {
+    xOut_.clear();
+    yOut_.clear();
+    ringsEnd_.clear();
+
+    for (std::size_t partIndex = 0; partIndex < entity.partsCount(); ++partIndex) {
+        clipRing(entity.part(partIndex));
+    }
+
+    if (ringsEnd_.empty()) {
+        return false;
+    }
+
+    geometryIndex = geometry.beginEntity();
+
+    std::size_t ringBegin = 0;
+    for (std::size_t ringEnd : ringsEnd_) {
+        geometry.beginPart();
+        geometry.addPoints(xOut_.data() + ringBegin, yOut_.data() + ringBegin,
+                           ringEnd - ringBegin);
+        ringBegin = ringEnd;
+    }
+
+    return true;
+}
+
+void GisRectangleClipper::clipRing(const GisPointsSpan &ring) {
+    x_.assign(ring.x(), ring.x() + ring.size());
+    y_.assign(ring.y(), ring.y() + ring.size());
+
+    // Rings of files repeat the first vertex at the end, the clipped ring will do the same.
+    bool closed = ring.size() > 1 && x_.front() == x_.back() && y_.front() == y_.back();
+    if (closed) {
+        x_.pop_back();
+        y_.pop_back();
+    }
+
+    for (Side side : {SideLeft, SideRight, SideBottom, SideTop}) {
+        clipBySide(side);
+    }
+
+    appendJoinedRings(closed);
+}
+
+void GisRectangleClipper::clipBySide(Side side) {
+    xNext_.clear();
+    yNext_.clear();
+
+    std::size_t count = x_.size();
+    if (count == 0) {
+        return;
+    }
+
+    // Vertices of crossings are put exactly on the side.
+    auto addCrossing = [&](double xFrom, double yFrom, double xTo, double yTo) {
+        if (side == SideLeft || side == SideRight) {
+            double sideX = side == SideLeft ? rectangle_.minX() : rectangle_.maxX();
+            xNext_.push_back(sideX);
+            yNext_.push_back(yFrom + (yTo - yFrom) * (sideX - xFrom) / (xTo - xFrom));
+        } else {
+            double sideY = side == SideBottom ? rectangle_.minY() : rectangle_.maxY();
+            xNext_.push_back(xFrom + (xTo - xFrom) * (sideY - yFrom) / (yTo - yFrom));
+            yNext_.push_back(sideY);
+        }
+    };
+
+    double xPrevious = x_[count - 1];
+    double yPrevious = y_[count - 1];
+    bool isPreviousInside = isInside(side, xPrevious, yPrevious);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        bool isCurrentInside = isInside(side, x_[i], y_[i]);
+
+        if (isCurrentInside != isPreviousInside) {
+            addCrossing(xPrevious, yPrevious, x_[i], y_[i]);
+        }
+        if (isCurrentInside) {
+            xNext_.push_back(x_[i]);
+            yNext_.push_back(y_[i]);
+        }
+
+        xPrevious = x_[i];
+        yPrevious = y_[i];
+        isPreviousInside = isCurrentInside;
+    }
+
+    x_.swap(xNext_);
+    y_.swap(yNext_);
+}
+
+void GisRectangleClipper::appendJoinedRings(bool closed) {
+    std::size_t count = x_.size();
+    if (count < 3) {
+        return;
+    }
+
+    // Edges along the sides add no area, so the ring has the area and direction of the result.
+    double doubleArea = ringDoubleArea(x_, y_);
+    if (doubleArea == 0) {
+        return;
+    }
+    bool isCounterClockwise = doubleArea > 0;
+
+    auto isSideEdge = [&](std::size_t from) {
+        std::size_t to = from + 1 == count ? 0 : from + 1;
+        return isOnSide(x_[from], y_[from], x_[to], y_[to]);
+    };
+
+    // Pieces start after an edge along the sides, the first one found is the start of the walk.
+    std::size_t start = count;
+    for (std::size_t i = 0; i < count && start == count; ++i) {
+        if (isSideEdge(i == 0 ? count - 1 : i - 1) && !isSideEdge(i)) {
+            start = i;
+        }
+    }
+
+    // The ring is inside of the rectangle or goes only along its sides.
+    if (start == count) {
+        appendCleanRing(x_, y_, closed);
+        return;
+    }
+
+    chains_.clear();
+    for (std::size_t step = 0; step < count;) {
+        std::size_t first = (start + step) % count;
+        if (isSideEdge(first)) {
+            ++step;
+            continue;
+        }
+
+        std::size_t edgesCount = 0;
+        while (step < count && !isSideEdge((start + step) % count)) {
+            ++edgesCount;
+            ++step;
+        }
+
+        std::size_t last = (first + edgesCount) % count;
+        chains_.push_back({first, edgesCount + 1, sidesOffset(x_[first], y_[first]),
+                           sidesOffset(x_[last], y_[last]), false});
+    }
+
+    double perimeter =
+        2 * (rectangle_.maxX() - rectangle_.minX() + rectangle_.maxY() - rectangle_.minY());
+    std::size_t ringsCount = ringsEnd_.size();
+    std::size_t outCount = xOut_.size();
+    double joinedDoubleArea = 0;
+
+    for (std::size_t firstChain = 0; firstChain < chains_.size(); ++firstChain) {
+        if (chains_[firstChain].isUsed) {
+            continue;
+        }
+
+        xNext_.clear();
+        yNext_.clear();
+
+        // Every piece goes on with the nearest start of a piece in the direction of the ring.
+        std::size_t chainIndex = firstChain;
+        do {
+            Chain &chain = chains_[chainIndex];
+            chain.isUsed = true;
+            for (std::size_t i = 0; i < chain.count; ++i) {
+                std::size_t vertex = (chain.first + i) % count;
+                xNext_.push_back(x_[vertex]);
+                yNext_.push_back(y_[vertex]);
+            }
+
+            std::size_t nextChain = firstChain;
+            double nextDistance = perimeter;
+            for (std::size_t candidate = 0; candidate < chains_.size(); ++candidate) {
+                if (chains_[candidate].isUsed && candidate != firstChain) {
+                    continue;
+                }
+                double distance = isCounterClockwise
+                                      ? chains_[candidate].firstOffset - chain.lastOffset
+                                      : chain.lastOffset - chains_[candidate].firstOffset;
+                if (distance < 0) {
+                    distance += perimeter;
+                }
+                if (distance < nextDistance) {
+                    nextChain = candidate;
+                    nextDistance = distance;
+                }
+            }
+
+            addCorners(chain.lastOffset, chains_[nextChain].firstOffset, isCounterClockwise);
+            chainIndex = nextChain;
+        } while (chainIndex != firstChain);
+
+        if (xNext_.size() >= 3) {
+            joinedDoubleArea += ringDoubleArea(xNext_, yNext_);
+        }
+        appendCleanRing(xNext_, yNext_, closed);
+    }
+
+    // Pieces touching the sides at one point may be joined wrong, the ring is kept whole then.
+    if (std::fabs(joinedDoubleArea - doubleArea) > 1e-9 * std::fabs(doubleArea)) {
+        ringsEnd_.resize(ringsCount);
+        xOut_.resize(outCount);
+        yOut_.resize(outCount);
+        appendCleanRing(x_, y_, closed);
+    }
+}
+
+void GisRectangleClipper::addCorners(double fromOffset, double toOffset,
+                                     bool isCounterClockwise) {
+    double width = rectangle_.maxX() - rectangle_.minX();
+    double height = rectangle_.maxY() - rectangle_.minY();
+    double perimeter = 2 * (width + height);
+
+    const double cornersX[] = {rectangle_.minX(), rectangle_.maxX(), rectangle_.maxX(),
+                               rectangle_.minX()};
+    const double cornersY[] = {rectangle_.minY(), rectangle_.minY(), rectangle_.maxY(),
+                               rectangle_.maxY()};
+    const double cornersOffset[] = {0, width, width + height, 2 * width + height};
+
+    auto walkDistance = [&](double offset) {
+        double distance = isCounterClockwise ? offset - fromOffset : fromOffset - offset;
+        return distance < 0 ? distance + perimeter : distance;
+    };
+
+    // Corners strictly between the two positions, in the order they are passed.
+    double distance = walkDistance(toOffset);
+    double passedDistance = 0;
+    while (true) {
+        int nextCorner = -1;
+        double nextDistance = distance;
+        for (int corner = 0; corner < 4; ++corner) {
+            double cornerDistance = walkDistance(cornersOffset[corner]);
+            if (cornerDistance > passedDistance && cornerDistance < nextDistance) {
+                nextCorner = corner;
+                nextDistance = cornerDistance;
+            }
+        }
+        if (nextCorner < 0) {
+            break;
+        }
+
+        xNext_.push_back(cornersX[nextCorner]);
+        yNext_.push_back(cornersY[nextCorner]);
+        passedDistance = nextDistance;
+    }
+}
+
+void GisRectangleClipper::appendCleanRing(const std::vector<double> &x,
+                                          const std::vector<double> &y, bool closed) {
+    std::size_t ringBegin = xOut_.size();
+
+    // Vertex b between a and c is removed if it repeats c or if all three are on the same side.
+    auto isRedundant = [&](std::size_t a, std::size_t b, std::size_t c) {
+        double xB = xOut_[b];
+        double yB = yOut_[b];
+        if (xB == xOut_[c] && yB == yOut_[c]) {
+            return true;
+        }
+        bool isOnVerticalSide = xB == rectangle_.minX() || xB == rectangle_.maxX();
+        bool isOnHorizontalSide = yB == rectangle_.minY() || yB == rectangle_.maxY();
+        return (isOnVerticalSide && xOut_[a] == xB && xOut_[c] == xB) ||
+               (isOnHorizontalSide && yOut_[a] == yB && yOut_[c] == yB);
+    };
+
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        std::size_t ringEnd = xOut_.size();
+        if (ringEnd > ringBegin && xOut_[ringEnd - 1] == x[i] && yOut_[ringEnd - 1] == y[i]) {
+            continue;
+        }
+        xOut_.push_back(x[i]);
+        yOut_.push_back(y[i]);
+
+        // Removal may expose one more run, e.g. of a spike going back along the side.
+        while (xOut_.size() - ringBegin >= 3 &&
+               isRedundant(xOut_.size() - 3, xOut_.size() - 2, xOut_.size() - 1)) {
+            xOut_.erase(xOut_.end() - 2);
+            yOut_.erase(yOut_.end() - 2);
+        }
+    }
+
+    // The same around the place where the ring closes.
+    bool isChanged = true;
+    while (isChanged && xOut_.size() - ringBegin >= 3) {
+        std::size_t last = xOut_.size() - 1;
+        isChanged = false;
+
+        if (isRedundant(last - 1, last, ringBegin)) {
+            xOut_.pop_back();
+            yOut_.pop_back();
+            isChanged = true;
+        } else if (isRedundant(last, ringBegin, ringBegin + 1)) {
+            xOut_.erase(xOut_.begin() + ringBegin);
+            yOut_.erase(yOut_.begin() + ringBegin);
+            isChanged = true;
+        }
+    }
+
+    // Rings with less than three vertices have no area.
+    if (xOut_.size() - ringBegin < 3) {
+        xOut_.resize(ringBegin);
+        yOut_.resize(ringBegin);
+        return;
+    }
+
+    if (closed) {
+        xOut_.push_back(xOut_[ringBegin]);
+        yOut_.push_back(yOut_[ringBegin]);
+    }
+    ringsEnd_.push_back(xOut_.size());
+}
+
+bool GisRectangleClipper::isInside(Side side, double x, double y) const {
+    switch (side) {
+        case SideLeft:
+            return x >= rectangle_.minX();
+        case SideRight:
+            return x <= rectangle_.maxX();
+        case SideBottom:
+            return y >= rectangle_.minY();
+        case SideTop:
+            return y <= rectangle_.maxY();
+    }
+
+    return false;
+}
+
+bool GisRectangleClipper::isOnSide(double xFrom, double yFrom, double xTo, double yTo) const {
+    return (xFrom == xTo && (xFrom == rectangle_.minX() || xFrom == rectangle_.maxX())) ||
+           (yFrom == yTo && (yFrom == rectangle_.minY() || yFrom == rectangle_.maxY()));
+}
+
+double GisRectangleClipper::sidesOffset(double x, double y) const {
+    double width = rectangle_.maxX() - rectangle_.minX();
+    double height = rectangle_.maxY() - rectangle_.minY();
+
+    if (y == rectangle_.minY()) {
+        return x - rectangle_.minX();
+    }
+    if (x == rectangle_.maxX()) {
+        return width + y - rectangle_.minY();
+    }
+    if (y == rectangle_.maxY()) {
+        return width + height + rectangle_.maxX() - x;
+    }
+    return 2 * width + height + rectangle_.maxY() - y;
+}
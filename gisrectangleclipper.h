@@ -0,0 +1,114 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisRectangleClipper.
+  */
+
+#include <vector>
+
+#include "gisentity.h"
+#include "gisenvelope.h"
+#include "gisgeometrystore.h"
+
+/**
+ * @brief Clipper of polygons by an axis-aligned rectangle on double coordinates.
+ * @details Every ring is clipped by the four sides of the rectangle in turn
+ * (Sutherland-Hodgman). Edges it leaves along the sides may run back and
+ * forth between pieces of a concave ring, so they are dropped, and pieces
+ * inside of the rectangle are joined along its sides in the direction the
+ * ring goes around. A ring split by the rectangle becomes several rings.
+ * Repeated vertices and vertices inside of straight runs along the sides are
+ * removed, so clipping leaves no spikes, and rings without area are dropped.
+ * Buffers are reused between calls, so clipping allocates nothing once they
+ * have grown.
+ */
+class GisRectangleClipper {
+   public:
+    explicit GisRectangleClipper(const GisEnvelope& rectangle);
+
+    /**
+     * @brief Append intersection of the polygon with the rectangle to the store.
+     * @param entity - polygon with a ring in every part.
+     * @param geometry - store to append to.
+     * @param geometryIndex - index of the appended entity inside of the store.
+     * @return True - if the intersection isn't empty, it is appended as a new
+     * entity with a part per clipped ring. False - otherwise, the store stays
+     * unchanged.
+     */
+    bool clipPolygon(const GisEntity& entity, GisGeometryStore& geometry,
+                     std::size_t& geometryIndex);
+
+   private:
+    enum Side { SideLeft, SideRight, SideBottom, SideTop };
+
+    /**
+     * @brief Piece of the clipped ring between two points on the sides.
+     */
+    struct Chain {
+        std::size_t first;   ///< index of the first vertex in x_ and y_
+        std::size_t count;   ///< number of vertices, indices wrap around the ring
+        double firstOffset;  ///< position of the first vertex along the sides
+        double lastOffset;   ///< position of the last vertex along the sides
+        bool isUsed;
+    };
+
+    /**
+     * @brief Clip the ring and append the result to xOut_ and yOut_.
+     */
+    void clipRing(const GisPointsSpan& ring);
+
+    /**
+     * @brief Clip the ring in x_ and y_ by the side, keeping the result there.
+     */
+    void clipBySide(Side side);
+
+    /**
+     * @brief Join pieces of the ring in x_ and y_ along the sides and append
+     * the rings they make up to xOut_ and yOut_.
+     * @param closed - whether to repeat the first vertex at the end of rings.
+     */
+    void appendJoinedRings(bool closed);
+
+    /**
+     * @brief Append the ring to xOut_ and yOut_ without repeated vertices and
+     * vertices inside of runs along the sides.
+     * @param x - x coordinates of the ring.
+     * @param y - y coordinates of the ring.
+     * @param closed - whether to repeat the first vertex at the end.
+     */
+    void appendCleanRing(const std::vector<double>& x, const std::vector<double>& y,
+                         bool closed);
+
+    /**
+     * @brief Append corners of the rectangle passed from one position along
+     * the sides to another one to xNext_ and yNext_.
+     * @param fromOffset - position to go from.
+     * @param toOffset - position to go to.
+     * @param isCounterClockwise - direction to go in.
+     */
+    void addCorners(double fromOffset, double toOffset, bool isCounterClockwise);
+
+    bool isInside(Side side, double x, double y) const;
+
+    /**
+     * @brief Check whether the edge lies on one of the sides.
+     */
+    bool isOnSide(double xFrom, double yFrom, double xTo, double yTo) const;
+
+    /**
+     * @brief Position of the point on the sides, counter-clockwise from the
+     * bottom left corner.
+     */
+    double sidesOffset(double x, double y) const;
+
+    GisEnvelope rectangle_;
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> xNext_;
+    std::vector<double> yNext_;
+    std::vector<double> xOut_;
+    std::vector<double> yOut_;
+    std::vector<std::size_t> ringsEnd_;  // index in xOut_ after the last vertex of every ring
+    std::vector<Chain> chains_;
+};
@@ -0,0 +1,314 @@
+#include "gisrtree.h"
+
+#include "gisparallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace {
+
+// Children per node, 16 boxes of a node take 512 bytes.
+const std::size_t nodeSize = 16;
+
+// Loops over boxes are split into tasks of that many boxes.
+const std::size_t boxesPerTask = 64 * 1024;
+
+/**
+ * @brief Key to sort boxes by with position of the box inside of its level.
+ */
+struct SortKey {
+    double key;
+    std::size_t position;
+};
+
+// Position breaks ties, so the tree doesn't depend on number of threads.
+bool isKeyLess(const SortKey &a, const SortKey &b) {
+    return a.key < b.key || (a.key == b.key && a.position < b.position);
+}
+
+// Empty boxes go to the end.
+double centerX(const GisEnvelope &box) {
+    return box.isEmpty() ? std::numeric_limits<double>::max() : (box.minX() + box.maxX()) / 2;
+}
+
+double centerY(const GisEnvelope &box) {
+    return box.isEmpty() ? std::numeric_limits<double>::max() : (box.minY() + box.maxY()) / 2;
+}
+
+/**
+ * @brief Squared distance from the point to the box.
+ * @return Zero if the box contains the point, infinity if the box is empty.
+ */
+double boxDistance2(const GisEnvelope &box, double x, double y) {
+    if (box.isEmpty()) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    double dx = std::max({box.minX() - x, x - box.maxX(), 0.0});
+    double dy = std::max({box.minY() - y, y - box.maxY(), 0.0});
+
+    return dx * dx + dy * dy;
+}
+
+/**
+ * @brief Run the function over ranges of [0, count) on several threads.
+ * @param function - function called with begin and end of a range.
+ */
+template <typename Function>
+void parallelRanges(std::size_t count, int threadsCount, const Function &function) {
+    std::size_t tasksCount = (count + boxesPerTask - 1) / boxesPerTask;
+    gisParallelFor(tasksCount, threadsCount, [&](std::size_t iTaskNumber, int) {
+        function(iTaskNumber * boxesPerTask, std::min(count, (iTaskNumber + 1) * boxesPerTask));
+    });
+}
+
+/**
+ * @brief Sort keys on several threads.
+ * @details Chunks are sorted in parallel, then pairs of sorted runs are merged
+ * in parallel until one run is left.
+ */
+void parallelSort(std::vector<SortKey> &keys, int threadsCount) {
+    std::size_t count = keys.size();
+    std::size_t chunksCount = count < 2 * boxesPerTask ? 1 : gisThreadsCount(threadsCount);
+    std::size_t chunkSize = (count + chunksCount - 1) / chunksCount;
+
+    gisParallelFor(chunksCount, threadsCount, [&](std::size_t chunk, int) {
+        std::sort(keys.begin() + std::min(count, chunk * chunkSize),
+                  keys.begin() + std::min(count, (chunk + 1) * chunkSize), isKeyLess);
+    });
+    if (chunksCount == 1) {
+        return;
+    }
+
+    std::vector<SortKey> merged(count);
+    for (std::size_t width = chunkSize; width < count; width *= 2) {
+        std::size_t pairsCount = (count + 2 * width - 1) / (2 * width);
+
+        gisParallelFor(pairsCount, threadsCount, [&](std::size_t pair, int) {
+            std::size_t begin = pair * 2 * width;
+            std::size_t middle = std::min(count, begin + width);
+            std::size_t end = std::min(count, begin + 2 * width);
+            std::merge(keys.begin() + begin, keys.begin() + middle, keys.begin() + middle,
+                       keys.begin() + end, merged.begin() + begin, isKeyLess);
+        });
+        keys.swap(merged);
+    }
+}
+
+} // namespace
+
+GisRTree::GisRTree() = default;
+
+void GisRTree::build(const std::vector<GisEnvelope> &envelopes, int threadsCount) {
+    clear();
+
+    boxes_ = envelopes;
+    indices_.resize(envelopes.size());
+    parallelRanges(envelopes.size(), threadsCount, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            indices_[i] = i;
+        }
+    });
+
+    pack(threadsCount);
+}
+
+void GisRTree::build(const std::vector<GisEntity> &entities, int threadsCount) {
+    clear();
+
+    boxes_.resize(entities.size());
+    indices_.resize(entities.size());
+    parallelRanges(entities.size(), threadsCount, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            boxes_[i] = entities[i].envelope();
+            indices_[i] = i;
+        }
+    });
+
+    pack(threadsCount);
+}
+
+void GisRTree::clear() {
+    boxes_.clear();
+    indices_.clear();
+    levelsEnd_.clear();
+}
+
+std::size_t GisRTree::itemsCount() const { return levelsEnd_.empty() ? 0 : levelsEnd_.front(); }
+
+bool GisRTree::isEmpty() const { return boxes_.empty(); }
+
+GisEnvelope GisRTree::envelope() const { return boxes_.empty() ? GisEnvelope() : boxes_.back(); }
+
+void GisRTree::query(const GisEnvelope &envelope, std::vector<std::size_t> &items) const {
+    if (boxes_.empty() || !boxes_.back().intersects(envelope)) {
+        return;
+    }
+
+    // Nodes to visit with their levels, nodes of level 1 give items directly.
+    std::vector<std::pair<std::size_t, std::size_t>> nodes;
+    nodes.reserve(nodeSize * levelsEnd_.size());
+    nodes.emplace_back(boxes_.size() - 1, levelsEnd_.size() - 1);
+
+    while (!nodes.empty()) {
+        std::size_t node = nodes.back().first;
+        std::size_t level = nodes.back().second;
+        nodes.pop_back();
+
+        std::size_t end = childrenEnd(node, level);
+        for (std::size_t child = indices_[node]; child < end; ++child) {
+            if (!boxes_[child].intersects(envelope)) {
+                continue;
+            }
+            if (level == 1) {
+                items.push_back(indices_[child]);
+            } else {
+                nodes.emplace_back(child, level - 1);
+            }
+        }
+    }
+}
+
+void GisRTree::queryPoint(double x, double y, std::vector<std::size_t> &items) const {
+    query(GisEnvelope(x, y, x, y), items);
+}
+
+void GisRTree::nearest(double x, double y, std::size_t count,
+                       std::vector<std::size_t> &items) const {
+    if (boxes_.empty() || count == 0) {
+        return;
+    }
+
+    // Best first: boxes are visited in order of distance, so an item taken
+    // from the queue is nearer than everything left in it.
+    struct Candidate {
+        double distance2;
+        std::size_t box;
+        std::size_t level;
+
+        bool operator>(const Candidate &other) const { return distance2 > other.distance2; }
+    };
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+
+    double rootDistance2 = boxDistance2(boxes_.back(), x, y);
+    if (std::isinf(rootDistance2)) {
+        return;
+    }
+    candidates.push({rootDistance2, boxes_.size() - 1, levelsEnd_.size() - 1});
+
+    std::size_t found = 0;
+    while (!candidates.empty() && found < count) {
+        Candidate candidate = candidates.top();
+        candidates.pop();
+
+        if (candidate.level == 0) {
+            items.push_back(indices_[candidate.box]);
+            ++found;
+            continue;
+        }
+
+        std::size_t end = childrenEnd(candidate.box, candidate.level);
+        for (std::size_t child = indices_[candidate.box]; child < end; ++child) {
+            double distance2 = boxDistance2(boxes_[child], x, y);
+            if (!std::isinf(distance2)) {
+                candidates.push({distance2, child, candidate.level - 1});
+            }
+        }
+    }
+}
+
+std::size_t GisRTree::memoryUsage() const {
+    return boxes_.capacity() * sizeof(GisEnvelope) + indices_.capacity() * sizeof(std::size_t) +
+           levelsEnd_.capacity() * sizeof(std::size_t);
+}
+
+void GisRTree::pack(int threadsCount) {
+    if (boxes_.empty()) {
+        return;
+    }
+
+    // Boxes of all levels are reserved, so packing doesn't move them.
+    std::size_t boxesCount = boxes_.size();
+    std::size_t levelCount = boxes_.size();
+    do {
+        levelCount = (levelCount + nodeSize - 1) / nodeSize;
+        boxesCount += levelCount;
+    } while (levelCount > 1);
+    boxes_.reserve(boxesCount);
+    indices_.reserve(boxesCount);
+
+    // Even one item gets a node above it, so the root is always a node.
+    levelsEnd_.push_back(boxes_.size());
+    std::size_t parentsCount = 0;
+    do {
+        parentsCount = packLevel(threadsCount);
+    } while (parentsCount > 1);
+}
+
+std::size_t GisRTree::packLevel(int threadsCount) {
+    std::size_t levelBegin = levelsEnd_.size() > 1 ? levelsEnd_[levelsEnd_.size() - 2] : 0;
+    std::size_t levelEnd = levelsEnd_.back();
+    std::size_t count = levelEnd - levelBegin;
+    std::size_t parentsCount = (count + nodeSize - 1) / nodeSize;
+
+    // Vertical slices of whole parents, about as many slices as parents in a slice.
+    auto slicesCount = static_cast<std::size_t>(std::ceil(std::sqrt(parentsCount)));
+    std::size_t sliceSize = nodeSize * ((parentsCount + slicesCount - 1) / slicesCount);
+
+    std::vector<SortKey> keys(count);
+    parallelRanges(count, threadsCount, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            keys[i] = {centerX(boxes_[levelBegin + i]), i};
+        }
+    });
+    parallelSort(keys, threadsCount);
+
+    std::size_t slicesTotal = (count + sliceSize - 1) / sliceSize;
+    gisParallelFor(slicesTotal, threadsCount, [&](std::size_t slice, int) {
+        std::size_t begin = slice * sliceSize;
+        std::size_t end = std::min(count, begin + sliceSize);
+        for (std::size_t i = begin; i < end; ++i) {
+            keys[i].key = centerY(boxes_[levelBegin + keys[i].position]);
+        }
+        std::sort(keys.begin() + begin, keys.begin() + end, isKeyLess);
+    });
+
+    // Boxes of the level are reordered, their children stay where they are.
+    std::vector<GisEnvelope> boxes(count);
+    std::vector<std::size_t> indices(count);
+    parallelRanges(count, threadsCount, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            boxes[i] = boxes_[levelBegin + keys[i].position];
+            indices[i] = indices_[levelBegin + keys[i].position];
+        }
+    });
+    std::copy(boxes.begin(), boxes.end(), boxes_.begin() + levelBegin);
+    std::copy(indices.begin(), indices.end(), indices_.begin() + levelBegin);
+
+    boxes_.resize(levelEnd + parentsCount);
+    indices_.resize(levelEnd + parentsCount);
+    parallelRanges(parentsCount, threadsCount, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t parent = begin; parent < end; ++parent) {
+            std::size_t childrenBegin = levelBegin + parent * nodeSize;
+            GisEnvelope box;
+            for (std::size_t child = childrenBegin;
+                 child < std::min(levelEnd, childrenBegin + nodeSize); ++child) {
+                box.expand(boxes_[child]);
+            }
+            boxes_[levelEnd + parent] = box;
+            indices_[levelEnd + parent] = childrenBegin;
+        }
+    });
+
+    levelsEnd_.push_back(levelEnd + parentsCount);
+
+    return parentsCount;
+}
+
+std::size_t GisRTree::childrenEnd(std::size_t node, std::size_t level) const {
+    return std::min(indices_[node] + nodeSize, levelsEnd_[level - 1]);
+}
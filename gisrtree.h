@@ -0,0 +1,103 @@
+#pragma once
+
+/**
+  @file
+  This file contains declaration of class GisRTree.
+  */
+
+#include <cstddef>
+#include <vector>
+
+#include "gisentity.h"
+#include "gisenvelope.h"
+
+/**
+ * @brief Static R-tree over envelopes of items packed by Sort-Tile-Recursive.
+ * @details The tree is built at once from all envelopes and can't be changed
+ * afterwards, so every node except the last one of a level is full. Boxes of
+ * items and nodes are kept in one flat array level by level with the root at
+ * the end, children of a node are consecutive boxes of the level below. Items
+ * are identified by their index in the list the tree was built from.
+ */
+class GisRTree {
+   public:
+    GisRTree();
+
+    /**
+     * @brief Build the tree over envelopes, the previous tree is dropped.
+     * @param envelopes - envelopes of items, empty ones are never found.
+     * @param threadsCount - number of threads, see gisThreadsCount().
+     */
+    void build(const std::vector<GisEnvelope>& envelopes, int threadsCount = 0);
+
+    /**
+     * @brief Build the tree over envelopes of entities, the previous tree is
+     * dropped.
+     * @param entities - entities, the tree doesn't refer to them.
+     * @param threadsCount - number of threads, see gisThreadsCount().
+     */
+    void build(const std::vector<GisEntity>& entities, int threadsCount = 0);
+
+    void clear();
+
+    std::size_t itemsCount() const;
+
+    bool isEmpty() const;
+
+    /**
+     * @brief Get envelope of all items.
+     * @return Envelope of the root, empty if there are no items.
+     */
+    GisEnvelope envelope() const;
+
+    /**
+     * @brief Find items whose envelopes intersect the envelope.
+     * @param envelope - envelope to search in, its sides are included.
+     * @param items - indices of found items are appended to it in no particular order.
+     */
+    void query(const GisEnvelope& envelope, std::vector<std::size_t>& items) const;
+
+    /**
+     * @brief Find items whose envelopes contain the point.
+     * @param items - indices of found items are appended to it in no particular order.
+     */
+    void queryPoint(double x, double y, std::vector<std::size_t>& items) const;
+
+    /**
+     * @brief Find items whose envelopes are the nearest to the point.
+     * @details Distance to an item is distance to its envelope, so it is zero
+     * for all items whose envelopes contain the point. Callers refine it by
+     * geometry of items if they need to.
+     * @param count - number of items to find.
+     * @param items - indices of found items are appended to it, the nearest first.
+     */
+    void nearest(double x, double y, std::size_t count, std::vector<std::size_t>& items) const;
+
+    /**
+     * @brief Get number of bytes allocated by the tree.
+     */
+    std::size_t memoryUsage() const;
+
+   private:
+    /**
+     * @brief Add levels of nodes above boxes of items until one root is left.
+     */
+    void pack(int threadsCount);
+
+    /**
+     * @brief Sort boxes of the last level by Sort-Tile-Recursive and add the
+     * level of their parents.
+     * @return Number of the parents.
+     */
+    std::size_t packLevel(int threadsCount);
+
+    /**
+     * @brief Get index in boxes_ after the last child of the node.
+     * @param level - level of the node, above 0.
+     */
+    std::size_t childrenEnd(std::size_t node, std::size_t level) const;
+
+    std::vector<GisEnvelope> boxes_;
+    std::vector<std::size_t> indices_;    // item of a box of level 0, first child of a node
+    std::vector<std::size_t> levelsEnd_;  // index in boxes_ after the last box of every level
+};
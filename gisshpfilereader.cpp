@@ -1,104 +1,1064 @@
 #include "gisshpfilereader.h"
 
+#include "gismappedfile.h"
+#include "gisparallel.h"
 #include "shapelib/shapefil.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string_view>
 
 namespace {
 
+// Size of the header of .shp and .shx files.
+const std::size_t shapefileHeaderSize = 100;
+
+// Minimal number of records decoded by one parallel task.
+const int minRecordsPerTask = 1024;
+
 /**
-    * @brief Fill entity.points() with points from SHPObject.
-    * @param entity - GisEntity class, for containing information about a
-    * feature.
+    * @brief Append points from SHPObject as a new entity of the geometry store.
+    * @param geometry - GisGeometryStore of the layer.
     * @param shpObject - SHPObject, that we get in openFile() function.
+    * @return Index of the entity inside of the geometry store.
     */
-void fillEntityWithPoints(GisEntity& entity, const SHPObject* shpObject) {
-    for (int iVertexNumber = 0; iVertexNumber < shpObject->nVertices; ++iVertexNumber) {
-        entity.addPoint(GAPoint(shpObject->padfX[iVertexNumber], shpObject->padfY[iVertexNumber]));
+std::size_t fillGeometryWithPoints(GisGeometryStore& geometry, const SHPObject* shpObject) {
+    std::size_t geometryIndex = geometry.beginEntity();
+
+    if (!shpObject) {
+        return geometryIndex;
+    }
+
+    for (int iPartNumber = 0; iPartNumber < std::max(shpObject->nParts, 1); ++iPartNumber) {
+        int iPartBegin = shpObject->nParts > 0 ? shpObject->panPartStart[iPartNumber] : 0;
+        int iPartEnd = iPartNumber + 1 < shpObject->nParts
+                           ? shpObject->panPartStart[iPartNumber + 1]
+                           : shpObject->nVertices;
+        geometry.beginPart();
+        geometry.addPoints(shpObject->padfX + iPartBegin, shpObject->padfY + iPartBegin,
+                           iPartEnd - iPartBegin);
     }
+
+    return geometryIndex;
 }
 
 /**
-    * @brief Get iFieldNumber field from iRecordNumber entity from DBFHandle
-    * file as string.
-    * @param dbfFile - DBFHandle class that we get in openFile() function.
-    * @param iFieldNumber - Number of field we want to get.
-    * @param iRecordNumber - Index number of entity from file.
-    * @return Field value as string.
+    * @brief Get names of all fields of DBFHandle.
+    * @param dbfFile - DBFHandle of opened .dbf file.
+    * @return Names of the fields in order of the file.
     */
-std::string getFieldValueAsString(const DBFHandle dbfFile, int iFieldNumber,
-    int iRecordNumber) {
-    return std::string(DBFReadStringAttribute(dbfFile, iRecordNumber, iFieldNumber));
+std::vector<std::string> dbfFieldNames(const DBFHandle dbfFile) {
+    std::vector<std::string> fieldNames(DBFGetFieldCount(dbfFile));
+
+    char pcFieldName[12];
+    for (std::size_t iFieldNumber = 0; iFieldNumber < fieldNames.size(); ++iFieldNumber) {
+        DBFGetFieldInfo(dbfFile, static_cast<int>(iFieldNumber), pcFieldName, nullptr, nullptr);
+        fieldNames[iFieldNumber] = pcFieldName;
+    }
+
+    return fieldNames;
 }
 
 /**
-    * @brief Fill entity.fields() with fields from DBFHandle
-    * @param dbfFile - DBFHandle class that we get in openFile() function.
-    * @param entity - GisEntity class, for containing information about a
-    * feature.
-    * @param iEntityNumber - Index number of entity from file.
+    * @brief Get type of column that keeps values of the field.
+    * @details Numeric fields without decimals that fit 64 bits become integer
+    * columns, other numeric fields become double columns printed with their
+    * number of decimals.
+    * @param dbfFile - DBFHandle of opened .dbf file.
+    * @param iFieldNumber - index of the field in the file.
+    * @param fieldName - name of the field.
+    * @param precision - number of decimals for double columns, -1 otherwise.
+    * @return Type of the column.
     */
-void fillEntityWithFields(const DBFHandle dbfFile, GisEntity& entity,
-    int iEntityNumber) {
+GisAttributeTable::FieldType fieldColumnType(const DBFHandle dbfFile, int iFieldNumber,
+    std::string& fieldName, int& precision) {
     char pcFieldName[12];
-    int iNumOfFields = DBFGetFieldCount(dbfFile);
-    for (int iFieldNumber = 0; iFieldNumber < iNumOfFields; ++iFieldNumber) {
-        // Get field name
-        DBFGetFieldInfo(dbfFile, iFieldNumber, pcFieldName, nullptr, nullptr);
-        // Get field value
-        std::string sFieldValue = getFieldValueAsString(dbfFile, iFieldNumber, iEntityNumber);
-        // Set name and value to entity
-        entity.addField(GisField(std::string(pcFieldName), sFieldValue));
+    int iWidth;
+    int iDecimals;
+    DBFFieldType fieldType =
+        DBFGetFieldInfo(dbfFile, iFieldNumber, pcFieldName, &iWidth, &iDecimals);
+
+    fieldName = pcFieldName;
+    precision = -1;
+
+    switch (fieldType) {
+        case FTInteger:
+            return GisAttributeTable::FieldTypeInteger;
+        case FTDouble:
+            if (iDecimals == 0 && iWidth <= 18) {
+                return GisAttributeTable::FieldTypeInteger;
+            }
+            precision = iDecimals;
+            return GisAttributeTable::FieldTypeDouble;
+        case FTDate:
+            return GisAttributeTable::FieldTypeDate;
+        default:
+            return GisAttributeTable::FieldTypeString;
+    }
+}
+
+/**
+    * @brief Describe columns of attributes by fields of DBFHandle.
+    * @param dbfFile - DBFHandle of opened .dbf file.
+    * @param fields - indices of the fields to describe.
+    * @param attributes - GisAttributeTable without columns.
+    */
+void fillAttributesSchema(const DBFHandle dbfFile, const std::vector<int>& fields,
+    GisAttributeTable& attributes) {
+    std::string fieldName;
+    int precision;
+
+    for (int iFieldNumber : fields) {
+        GisAttributeTable::FieldType type =
+            fieldColumnType(dbfFile, iFieldNumber, fieldName, precision);
+        attributes.addColumn(fieldName, type, precision);
     }
 }
 
+/**
+    * @brief Append fields of iEntityNumber record from DBFHandle as a new row of
+    * attributes.
+    * @details Values are parsed into types of the columns, empty numbers and
+    * dates stay null.
+    * @param dbfFile - DBFHandle of opened .dbf file.
+    * @param iEntityNumber - Index number of entity from file.
+    * @param fields - indices of the fields of the columns.
+    * @param attributes - GisAttributeTable with columns filled by fillAttributesSchema().
+    * @return Index of the row inside of the attribute table.
+    */
+std::size_t readRecordAttributes(const DBFHandle dbfFile, int iEntityNumber,
+    const std::vector<int>& fields, GisAttributeTable& attributes) {
+    std::size_t row = attributes.addRow();
+
+    for (std::size_t column = 0; column < fields.size(); ++column) {
+        attributes.setString(row, column,
+                             DBFReadStringAttribute(dbfFile, iEntityNumber, fields[column]));
+    }
+
+    return row;
+}
+
+/**
+    * @brief Whether the host stores numbers in big-endian byte order.
+    * @return True - for big-endian hosts. False - otherwise.
+    */
+bool isHostBigEndian() {
+    const std::uint16_t word = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &word, 1);
+    return firstByte == 0;
+}
+
+const bool hostBigEndian = isHostBigEndian();
+
+/**
+    * @brief Read value of type T stored at data with given byte order.
+    * @param data - pointer to the first byte of the value, may be unaligned.
+    * @param bigEndian - byte order of the stored value.
+    * @return Value in host byte order.
+    */
+template <typename T>
+T readValue(const unsigned char* data, bool bigEndian) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, data, sizeof(T));
+    if (bigEndian != hostBigEndian) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+template <typename T>
+T readLittleEndian(const unsigned char* data) {
+    return readValue<T>(data, false);
+}
+
+template <typename T>
+T readBigEndian(const unsigned char* data) {
+    return readValue<T>(data, true);
+}
+
+/**
+    * @brief Get name of the file that accompanies shapefile, e.g. .shx for .shp.
+    * @param filename - name of any file of the shapefile.
+    * @param extension - extension of the needed file without dot.
+    * @return Name of the file with replaced extension.
+    */
+std::string siblingFilename(const std::string& filename, const std::string& extension) {
+    std::size_t dotPosition = filename.find_last_of('.');
+    std::size_t slashPosition = filename.find_last_of("/\\");
+    if (dotPosition == std::string::npos ||
+        (slashPosition != std::string::npos && dotPosition < slashPosition)) {
+        return filename + "." + extension;
+    }
+    return filename.substr(0, dotPosition + 1) + extension;
+}
+
+/**
+    * @brief Get name of the file that accompanies shapefile in the same letter
+    * case as extension of the shapefile, e.g. .QIX for .SHP.
+    * @param filename - name of any file of the shapefile.
+    * @param extension - extension of the needed file in lower case without dot.
+    * @return Name of the file with replaced extension.
+    */
+std::string siblingFilenameSameCase(const std::string& filename, const std::string& extension) {
+    std::size_t dotPosition = filename.find_last_of('.');
+    if (dotPosition != std::string::npos && dotPosition + 1 < filename.size() &&
+        std::isupper(static_cast<unsigned char>(filename[dotPosition + 1]))) {
+        std::string extensionUpperCase = extension;
+        std::transform(extension.begin(), extension.end(), extensionUpperCase.begin(),
+                       ::toupper);
+        return siblingFilename(filename, extensionUpperCase);
+    }
+    return siblingFilename(filename, extension);
+}
+
+/**
+    * @brief Get modification time of file of the shapefile with lower or upper
+    * case extension.
+    * @param filename - name of any file of the shapefile.
+    * @param extension - extension of the needed file in lower case without dot.
+    * @param time - modification time of the file.
+    * @return True - if the file exists. False - otherwise.
+    */
+bool siblingFileTime(const std::string& filename, const std::string& extension,
+    std::filesystem::file_time_type& time) {
+    std::string extensionUpperCase = extension;
+    std::transform(extension.begin(), extension.end(), extensionUpperCase.begin(), ::toupper);
+
+    for (const std::string& siblingExtension : {extension, extensionUpperCase}) {
+        std::error_code error;
+        time = std::filesystem::last_write_time(siblingFilename(filename, siblingExtension), error);
+        if (!error) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+    * @brief Check whether spatial index file of the shapefile exists and is up
+    * to date.
+    * @details An index older than .shp file was built for an earlier version
+    * of it, so it may miss records and isn't used.
+    * @param filename - name of any file of the shapefile.
+    * @param extension - extension of the index file in lower case without dot.
+    * @return True - if the index can be used. False - otherwise.
+    */
+bool isSpatialIndexCurrent(const std::string& filename, const std::string& extension) {
+    std::filesystem::file_time_type indexTime;
+    if (!siblingFileTime(filename, extension, indexTime)) {
+        return false;
+    }
+
+    std::filesystem::file_time_type shpTime;
+    return !siblingFileTime(filename, "shp", shpTime) || indexTime >= shpTime;
+}
+
+/**
+    * @brief Map file of the shapefile trying lower and upper case extension.
+    * @param mappedFile - GisMappedFile to open.
+    * @param filename - name of any file of the shapefile.
+    * @param extension - extension of the needed file in lower case without dot.
+    * @return True - if file was mapped successfully. False - otherwise.
+    */
+bool openSiblingFile(GisMappedFile& mappedFile, const std::string& filename,
+    const std::string& extension) {
+    std::string extensionUpperCase = extension;
+    std::transform(extension.begin(), extension.end(), extensionUpperCase.begin(), ::toupper);
+
+    return mappedFile.open(siblingFilename(filename, extension)) ||
+           mappedFile.open(siblingFilename(filename, extensionUpperCase));
+}
+
+/**
+    * @brief Records of .dbf file that rows of a lazy attribute table come from.
+    */
+struct DbfRowsSource {
+    std::string filename;
+    std::vector<int> records;  // record of every row, empty if rows are all records
+};
+
+/**
+    * @brief Fill column of attributes with values of the field taken straight
+    * from memory mapped .dbf file.
+    * @details Values are trimmed the same way DBFReadStringAttribute() does, so
+    * the column gets the same values as an eagerly read one.
+    * @param source - file and records of the rows.
+    * @param iFieldNumber - index of the field in the file.
+    * @param attributes - table to fill.
+    * @param column - index of the column of the field.
+    */
+void loadDbfColumn(const DbfRowsSource& source, int iFieldNumber, GisAttributeTable& attributes,
+    std::size_t column) {
+    // Only the header is read by DBFOpen(), records are taken from the mapping.
+    DBFHandle dbfFile = DBFOpen(source.filename.c_str(), "rb");
+    if (!dbfFile) {
+        return;
+    }
+
+    std::size_t headerLength = dbfFile->nHeaderLength;
+    std::size_t recordLength = dbfFile->nRecordLength;
+    std::size_t fieldOffset = dbfFile->panFieldOffset[iFieldNumber];
+    std::size_t fieldSize = dbfFile->panFieldSize[iFieldNumber];
+    DBFClose(dbfFile);
+
+    GisMappedFile mappedFile;
+    if (!openSiblingFile(mappedFile, source.filename, "dbf")) {
+        return;
+    }
+
+    for (std::size_t row = 0; row < attributes.rowsCount(); ++row) {
+        std::size_t record = source.records.empty() ? row : source.records[row];
+        std::size_t recordOffset = headerLength + record * recordLength;
+        if (recordOffset + recordLength > mappedFile.size()) {
+            break;
+        }
+
+        const char* field =
+            reinterpret_cast<const char*>(mappedFile.data() + recordOffset + fieldOffset);
+        std::string_view value(field, fieldSize);
+        value = value.substr(0, value.find('\0'));
+
+        std::size_t first = value.find_first_not_of(' ');
+        std::size_t last = value.find_last_not_of(' ');
+        value = first == std::string_view::npos ? std::string_view()
+                                                : value.substr(first, last - first + 1);
+
+        attributes.setString(row, column, value);
+    }
+}
+
+/**
+    * @brief Describe columns of attributes by fields of DBFHandle, values of
+    * the columns are read from the file on first access.
+    * @param dbfFile - DBFHandle of opened .dbf file.
+    * @param fields - indices of the fields to describe.
+    * @param source - file and records of the rows.
+    * @param attributes - GisAttributeTable without columns.
+    */
+void fillLazyAttributesSchema(const DBFHandle dbfFile, const std::vector<int>& fields,
+    const std::shared_ptr<const DbfRowsSource>& source, GisAttributeTable& attributes) {
+    std::string fieldName;
+    int precision;
+
+    for (int iFieldNumber : fields) {
+        GisAttributeTable::FieldType type =
+            fieldColumnType(dbfFile, iFieldNumber, fieldName, precision);
+        attributes.addLazyColumn(fieldName, type, precision,
+                                 [source, iFieldNumber](GisAttributeTable& table,
+                                                        std::size_t column) {
+                                     loadDbfColumn(*source, iFieldNumber, table, column);
+                                 });
+    }
+}
+
+/**
+    * @brief Decode shape record of .shp file as a new entity of the geometry store.
+    * @details Mirrors validation of SHPReadObject(): corrupted records produce an
+    * entity without points. Z and M values are skipped.
+    * @param geometry - GisGeometryStore of the layer.
+    * @param record - pointer to the record content (after the 8 bytes header).
+    * @param recordSize - size of the record content in bytes.
+    * @return Index of the entity inside of the geometry store.
+    */
+std::size_t decodeShapeRecord(GisGeometryStore& geometry, const unsigned char* record,
+    std::size_t recordSize) {
+    std::size_t geometryIndex = geometry.beginEntity();
+
+    if (recordSize < 4) {
+        return geometryIndex;
+    }
+
+    std::int32_t iShapeType = readLittleEndian<std::int32_t>(record);
+
+    std::size_t pointsOffset = 0;
+    std::uint32_t nPoints = 0;
+    std::uint32_t nParts = 0;
+
+    switch (iShapeType) {
+        case SHPT_POINT:
+        case SHPT_POINTZ:
+        case SHPT_POINTM:
+            pointsOffset = 4;
+            nPoints = 1;
+            break;
+        case SHPT_MULTIPOINT:
+        case SHPT_MULTIPOINTZ:
+        case SHPT_MULTIPOINTM:
+            if (recordSize < 40) {
+                return geometryIndex;
+            }
+            nPoints = readLittleEndian<std::uint32_t>(record + 36);
+            pointsOffset = 40;
+            break;
+        case SHPT_ARC:
+        case SHPT_ARCZ:
+        case SHPT_ARCM:
+        case SHPT_POLYGON:
+        case SHPT_POLYGONZ:
+        case SHPT_POLYGONM:
+        case SHPT_MULTIPATCH:
+            if (recordSize < 44) {
+                return geometryIndex;
+            }
+            nParts = readLittleEndian<std::uint32_t>(record + 36);
+            nPoints = readLittleEndian<std::uint32_t>(record + 40);
+            if (nPoints > 50 * 1000 * 1000 || nParts > 10 * 1000 * 1000) {
+                return geometryIndex;
+            }
+            pointsOffset = 44 + 4 * static_cast<std::size_t>(nParts);
+            if (iShapeType == SHPT_MULTIPATCH) {
+                // Part types are placed between part starts and points.
+                pointsOffset += 4 * static_cast<std::size_t>(nParts);
+            }
+            break;
+        default:
+            // SHPT_NULL or unknown type has no vertices.
+            return geometryIndex;
+    }
+
+    if (nPoints > 50 * 1000 * 1000 ||
+        pointsOffset + 16 * static_cast<std::size_t>(nPoints) > recordSize) {
+        return geometryIndex;
+    }
+
+    // Validate parts the same way shapelib does before touching the store.
+    const unsigned char* partStarts = record + 44;
+    for (std::uint32_t iPartNumber = 0; iPartNumber < nParts; ++iPartNumber) {
+        std::int32_t iPartBegin = readLittleEndian<std::int32_t>(partStarts + 4 * iPartNumber);
+        if (iPartBegin < 0 ||
+            (iPartBegin > 0 && static_cast<std::uint32_t>(iPartBegin) >= nPoints) ||
+            (iPartNumber > 0 &&
+             iPartBegin <= readLittleEndian<std::int32_t>(partStarts + 4 * (iPartNumber - 1)))) {
+            return geometryIndex;
+        }
+    }
+
+    const unsigned char* points = record + pointsOffset;
+
+    for (std::uint32_t iPartNumber = 0; iPartNumber < std::max<std::uint32_t>(nParts, 1);
+         ++iPartNumber) {
+        std::uint32_t iPartBegin =
+            nParts > 0 ? readLittleEndian<std::uint32_t>(partStarts + 4 * iPartNumber) : 0;
+        std::uint32_t iPartEnd =
+            iPartNumber + 1 < nParts
+                ? readLittleEndian<std::uint32_t>(partStarts + 4 * (iPartNumber + 1))
+                : nPoints;
+
+        // Coordinates are decoded straight into the store.
+        geometry.beginPart();
+        std::size_t first = geometry.appendPoints(iPartEnd - iPartBegin);
+        double* x = geometry.xData() + first;
+        double* y = geometry.yData() + first;
+
+        for (std::uint32_t iVertexNumber = iPartBegin; iVertexNumber < iPartEnd;
+             ++iVertexNumber) {
+            *x++ = readLittleEndian<double>(points + 16 * iVertexNumber);
+            *y++ = readLittleEndian<double>(points + 16 * iVertexNumber + 8);
+        }
+    }
+
+    return geometryIndex;
+}
+
+/**
+    * @brief Read entity iEntityNumber with shapelib.
+    * @param shapeFile - SHPHandle of opened .shp file.
+    * @param iEntityNumber - Index number of entity from file.
+    * @param geometry - GisGeometryStore to put points to.
+    * @return Index of the entity inside of the geometry store.
+    */
+std::size_t readRecordShapelib(SHPHandle shapeFile, int iEntityNumber,
+    GisGeometryStore& geometry) {
+    // Get entity
+    SHPObject* shpObject = SHPReadObject(shapeFile, iEntityNumber);
+
+    std::size_t geometryIndex = fillGeometryWithPoints(geometry, shpObject);
+
+    SHPDestroyObject(shpObject);
+
+    return geometryIndex;
+}
+
+/**
+    * @brief Find content of record iEntityNumber in memory mapped .shp file.
+    * @param shpFile - mapped .shp file.
+    * @param shxFile - mapped .shx file.
+    * @param iEntityNumber - Index number of entity from file.
+    * @param recordSize - size of the record content in bytes, 0 for corrupted records.
+    * @return Pointer to the record content (after the 8 bytes header).
+    */
+const unsigned char* findRecordMapped(const GisMappedFile& shpFile, const GisMappedFile& shxFile,
+    int iEntityNumber, std::size_t& recordSize) {
+    // Offset and length of the record are big-endian 16-bit word counts.
+    const unsigned char* shxRecord =
+        shxFile.data() + shapefileHeaderSize + 8 * static_cast<std::size_t>(iEntityNumber);
+    std::size_t recordOffset = 2 * static_cast<std::size_t>(
+                                       readBigEndian<std::uint32_t>(shxRecord));
+    recordSize = 2 * static_cast<std::size_t>(readBigEndian<std::uint32_t>(shxRecord + 4));
+
+    if (recordOffset + 8 > shpFile.size()) {
+        recordOffset = 0;
+        recordSize = 0;
+    } else if (recordSize > shpFile.size() - recordOffset - 8) {
+        // Some writers put record length including its header into .shx,
+        // trust .shp record header in that case as shapelib does.
+        const unsigned char* shpRecord = shpFile.data() + recordOffset;
+        std::size_t shpRecordSize = 2 * static_cast<std::size_t>(
+                                            readBigEndian<std::uint32_t>(shpRecord + 4));
+        recordSize = shpRecordSize + 8 == recordSize ? shpRecordSize : 0;
+    }
+
+    return shpFile.data() + recordOffset + 8;
+}
+
+/**
+    * @brief Decode entity iEntityNumber from memory mapped .shp file.
+    * @param shpFile - mapped .shp file.
+    * @param shxFile - mapped .shx file.
+    * @param iEntityNumber - Index number of entity from file.
+    * @param geometry - GisGeometryStore to put points to.
+    * @return Index of the entity inside of the geometry store.
+    */
+std::size_t readRecordMapped(const GisMappedFile& shpFile, const GisMappedFile& shxFile,
+    int iEntityNumber, GisGeometryStore& geometry) {
+    std::size_t recordSize;
+    const unsigned char* record = findRecordMapped(shpFile, shxFile, iEntityNumber, recordSize);
+
+    return decodeShapeRecord(geometry, record, recordSize);
+}
+
+/**
+    * @brief Check whether bounding box of the record stored in its header
+    * intersects the rectangle.
+    * @param record - pointer to the record content (after the 8 bytes header).
+    * @param recordSize - size of the record content in bytes.
+    * @param pdMin - minimal {x, y} of the rectangle.
+    * @param pdMax - maximal {x, y} of the rectangle.
+    * @return True - if the record has vertices inside of the rectangle bounds.
+    */
+bool recordIntersectsRect(const unsigned char* record, std::size_t recordSize,
+    const double* pdMin, const double* pdMax) {
+    if (recordSize < 4) {
+        return false;
+    }
+
+    double pdRecordMin[2];
+    double pdRecordMax[2];
+
+    switch (readLittleEndian<std::int32_t>(record)) {
+        case SHPT_POINT:
+        case SHPT_POINTZ:
+        case SHPT_POINTM:
+            if (recordSize < 20) {
+                return false;
+            }
+            pdRecordMin[0] = pdRecordMax[0] = readLittleEndian<double>(record + 4);
+            pdRecordMin[1] = pdRecordMax[1] = readLittleEndian<double>(record + 12);
+            break;
+        case SHPT_NULL:
+            return false;
+        default:
+            // All other shapes start with {xmin, ymin, xmax, ymax}.
+            if (recordSize < 36) {
+                return false;
+            }
+            pdRecordMin[0] = readLittleEndian<double>(record + 4);
+            pdRecordMin[1] = readLittleEndian<double>(record + 12);
+            pdRecordMax[0] = readLittleEndian<double>(record + 20);
+            pdRecordMax[1] = readLittleEndian<double>(record + 28);
+            break;
+    }
+
+    return pdRecordMin[0] <= pdMax[0] && pdRecordMax[0] >= pdMin[0] &&
+           pdRecordMin[1] <= pdMax[1] && pdRecordMax[1] >= pdMin[1];
+}
+
+/**
+    * @brief Get candidate records for the rectangle from .qix or .sbn spatial
+    * index of the shapefile.
+    * @details Indexes work with bounds of tree nodes, so candidates may lie
+    * outside of the rectangle and must be checked by their own bounds. Indexes
+    * older than .shp file are skipped.
+    * @param filename - name of any file of the shapefile.
+    * @param pdMin - minimal {x, y, z, m} of the rectangle.
+    * @param pdMax - maximal {x, y, z, m} of the rectangle.
+    * @param records - sorted numbers of candidate records.
+    * @return True - if the shapefile has a spatial index. False - otherwise.
+    */
+bool searchSpatialIndex(const std::string& filename, double* pdMin, double* pdMax,
+    std::vector<int>& records) {
+    int nShapeCount = 0;
+    int* panShapeIds = nullptr;
+
+    SHPTreeDiskHandle qixFile = nullptr;
+    if (isSpatialIndexCurrent(filename, "qix")) {
+        qixFile = SHPOpenDiskTree(siblingFilename(filename, "qix").c_str(), nullptr);
+        if (!qixFile) {
+            qixFile = SHPOpenDiskTree(siblingFilename(filename, "QIX").c_str(), nullptr);
+        }
+    }
+
+    if (qixFile) {
+        panShapeIds = SHPSearchDiskTreeEx(qixFile, pdMin, pdMax, &nShapeCount);
+        SHPCloseDiskTree(qixFile);
+        if (panShapeIds) {
+            records.assign(panShapeIds, panShapeIds + nShapeCount);
+            std::free(panShapeIds);
+            return true;
+        }
+    }
+
+    SBNSearchHandle sbnFile = nullptr;
+    if (isSpatialIndexCurrent(filename, "sbn")) {
+        sbnFile = SBNOpenDiskTree(siblingFilename(filename, "sbn").c_str(), nullptr);
+        if (!sbnFile) {
+            sbnFile = SBNOpenDiskTree(siblingFilename(filename, "SBN").c_str(), nullptr);
+        }
+    }
+
+    if (sbnFile) {
+        panShapeIds = SBNSearchDiskTree(sbnFile, pdMin, pdMax, &nShapeCount);
+        SBNCloseDiskTree(sbnFile);
+        if (panShapeIds) {
+            records.assign(panShapeIds, panShapeIds + nShapeCount);
+            SBNSearchFreeIds(panShapeIds);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 } // namespace
 
-GisShpFileReader::GisShpFileReader(const std::string& sFileName)
-    : GisFileReader(sFileName), iShapeType_(0), iNumOfEntities_(0) {}
+GisShpFileReader::GisShpFileReader(const std::string& sFileName, ReadMode readMode)
+    : GisFileReader(sFileName),
+      iShapeType_(0),
+      iNumOfEntities_(0),
+      readMode_(readMode),
+      threadsCount_(1),
+      autoBuildSpatialIndex_(true),
+      lazyAttributes_(false) {}
 
 bool GisShpFileReader::readFile() {
-    // Open files in readonly mode
-    SHPInfo* shapeFile = SHPOpen(filename_.c_str(), "rb");
-    DBFHandle dbfFile = DBFOpen(filename_.c_str(), "rb");
+    clearClipHistory();
+    entities_.clear();
+    geometry_->clear();
+    attributes_->clear();
+
+    int threadsCount = gisThreadsCount(threadsCount_);
+    auto readRecords = [&](const RecordReader& readRecord) {
+        return readEntities(threadsCount, readRecord);
+    };
+
+    return readMode_ == ReadModeMemoryMapped ? readMapped(readRecords)
+                                             : readShapelib(threadsCount, readRecords);
+}
+
+bool GisShpFileReader::readFileInRect(double minX, double minY, double maxX, double maxY) {
+    clearClipHistory();
+    entities_.clear();
+    geometry_->clear();
+    attributes_->clear();
+
+    // A failed build (e.g. read-only directory) isn't tried again for the same file.
+    if (autoBuildSpatialIndex_ && filename_ != spatialIndexFailedFilename_ &&
+        !hasSpatialIndex() && !buildSpatialIndex()) {
+        spatialIndexFailedFilename_ = filename_;
+    }
 
-    if (!shapeFile || !dbfFile) {
+    std::vector<int> records;
+    if (!selectRecordsInRect(minX, minY, maxX, maxY, records)) {
         return false;
     }
 
-    double pdMin[4];  // To get min coords {x, y, z, m}
-    double pdMax[4];  // To get max coords {x, y, z, m}
+    int threadsCount = gisThreadsCount(threadsCount_);
+    auto readRecords = [&](const RecordReader& readRecord) {
+        return readEntities(threadsCount, readRecord, &records);
+    };
 
-    // Get some information to get data about entities
-    SHPGetInfo(shapeFile, &iNumOfEntities_, &iShapeType_, pdMin, pdMax);
+    return readMode_ == ReadModeMemoryMapped ? readMapped(readRecords)
+                                             : readShapelib(threadsCount, readRecords);
+}
 
-    minX_ = pdMin[0];
-    minY_ = pdMin[1];
-    maxX_ = pdMax[0];
-    maxY_ = pdMax[1];
+bool GisShpFileReader::forEachEntity(const EntityVisitor& visitor) {
+    auto readRecords = [&](const RecordReader& readRecord) {
+        return visitEntities(readRecord, visitor);
+    };
 
-    entities_.clear();
+    return readMode_ == ReadModeMemoryMapped ? readMapped(readRecords)
+                                             : readShapelib(1, readRecords);
+}
 
-    // For each entity fill structure GisEntity and put it to entities_
-    for (int iEntityNumber = 0; iEntityNumber < iNumOfEntities_; ++iEntityNumber) {
-        // Get entity
-        SHPObject* shpObject = SHPReadObject(shapeFile, iEntityNumber);
+bool GisShpFileReader::buildSpatialIndex() {
+    SHPHandle shapeFile = SHPOpen(filename_.c_str(), "rb");
+    if (!shapeFile) {
+        return false;
+    }
+    SHPSetFastModeReadObject(shapeFile, 1);
+
+    // Depth of the tree is chosen by shapelib to keep about 8 shapes per node.
+    SHPTree* tree = SHPCreateTree(shapeFile, 2, 0, nullptr, nullptr);
+    bool writeResult = false;
+
+    if (tree) {
+        SHPTreeTrimExtraNodes(tree);
 
-        GisEntity newEntity;
-        fillEntityWithPoints(newEntity, shpObject);
-        fillEntityWithFields(dbfFile, newEntity, iEntityNumber);
-        entities_.push_back(newEntity);
+        // Write to a temporary file first, so readers never see a partial index.
+        std::string qixFilename = siblingFilenameSameCase(filename_, "qix");
+        std::string temporaryFilename = qixFilename + ".tmp";
+        writeResult = SHPWriteTreeLL(tree, temporaryFilename.c_str(), nullptr);
 
-        SHPDestroyObject(shpObject);
+        if (writeResult) {
+            std::remove(qixFilename.c_str());
+            writeResult = std::rename(temporaryFilename.c_str(), qixFilename.c_str()) == 0;
+        }
+        if (!writeResult) {
+            std::remove(temporaryFilename.c_str());
+        }
+
+        SHPDestroyTree(tree);
     }
 
-    DBFClose(dbfFile);
     SHPClose(shapeFile);
 
+    return writeResult;
+}
+
+bool GisShpFileReader::hasSpatialIndex() const {
+    return isSpatialIndexCurrent(filename_, "qix") || isSpatialIndexCurrent(filename_, "sbn");
+}
+
+bool GisShpFileReader::autoBuildSpatialIndex() const { return autoBuildSpatialIndex_; }
+
+void GisShpFileReader::setAutoBuildSpatialIndex(bool autoBuildSpatialIndex) {
+    autoBuildSpatialIndex_ = autoBuildSpatialIndex;
+}
+
+bool GisShpFileReader::lazyAttributes() const { return lazyAttributes_; }
+
+void GisShpFileReader::setLazyAttributes(bool lazyAttributes) { lazyAttributes_ = lazyAttributes; }
+
+GisShpFileReader::ReadMode GisShpFileReader::readMode() const { return readMode_; }
+
+void GisShpFileReader::setReadMode(ReadMode readMode) { readMode_ = readMode; }
+
+int GisShpFileReader::threadsCount() const { return threadsCount_; }
+
+void GisShpFileReader::setThreadsCount(int threadsCount) { threadsCount_ = threadsCount; }
+
+bool GisShpFileReader::readShapelib(int threadsCount, const RecordsConsumer& readRecords) {
+    // Open files in readonly mode, shapelib handles can't be shared between threads.
+    std::vector<SHPHandle> shapeFiles;
+    for (int iThreadNumber = 0; iThreadNumber < threadsCount; ++iThreadNumber) {
+        SHPHandle shapeFile = SHPOpen(filename_.c_str(), "rb");
+        if (!shapeFile) {
+            break;
+        }
+        // SHPReadObject() reuses the same buffers for every record.
+        SHPSetFastModeReadObject(shapeFile, 1);
+        shapeFiles.push_back(shapeFile);
+    }
+
+    bool readResult = false;
+
+    if (shapeFiles.size() == static_cast<std::size_t>(threadsCount)) {
+        double pdMin[4];  // To get min coords {x, y, z, m}
+        double pdMax[4];  // To get max coords {x, y, z, m}
+
+        // Get some information to get data about entities
+        SHPGetInfo(shapeFiles.front(), &iNumOfEntities_, &iShapeType_, pdMin, pdMax);
+
+        minX_ = pdMin[0];
+        minY_ = pdMin[1];
+        maxX_ = pdMax[0];
+        maxY_ = pdMax[1];
+
+        readResult = readRecords(
+            [&](int iThreadNumber, int iEntityNumber, GisGeometryStore& geometry) {
+                return readRecordShapelib(shapeFiles[iThreadNumber], iEntityNumber, geometry);
+            });
+    }
+
+    for (SHPHandle shapeFile : shapeFiles) {
+        SHPClose(shapeFile);
+    }
+
+    return readResult;
+}
+
+bool GisShpFileReader::readMapped(const RecordsConsumer& readRecords) {
+    GisMappedFile shpFile;
+    GisMappedFile shxFile;
+
+    if (!openSiblingFile(shpFile, filename_, "shp") ||
+        !openSiblingFile(shxFile, filename_, "shx") || shpFile.size() < shapefileHeaderSize ||
+        shxFile.size() < shapefileHeaderSize) {
+        return false;
+    }
+
+    // Main file header: file code and length are big-endian, the rest is little-endian.
+    const unsigned char* shpHeader = shpFile.data();
+    iShapeType_ = readLittleEndian<std::int32_t>(shpHeader + 32);
+    minX_ = readLittleEndian<double>(shpHeader + 36);
+    minY_ = readLittleEndian<double>(shpHeader + 44);
+    maxX_ = readLittleEndian<double>(shpHeader + 52);
+    maxY_ = readLittleEndian<double>(shpHeader + 60);
+
+    // Index file length is stored in 16-bit words, every record takes 8 bytes.
+    std::size_t shxLength = 2 * static_cast<std::size_t>(
+                                    readBigEndian<std::uint32_t>(shxFile.data() + 24));
+    std::size_t shxSize = std::max(std::min(shxLength, shxFile.size()), shapefileHeaderSize);
+    iNumOfEntities_ = static_cast<int>((shxSize - shapefileHeaderSize) / 8);
+
+    // The mapping is read-only, so all threads share it.
+    return readRecords([&](int, int iEntityNumber, GisGeometryStore& geometry) {
+        return readRecordMapped(shpFile, shxFile, iEntityNumber, geometry);
+    });
+}
+
+bool GisShpFileReader::selectRecordsInRect(double minX, double minY, double maxX, double maxY,
+                                           std::vector<int>& records) const {
+    GisMappedFile shpFile;
+    GisMappedFile shxFile;
+
+    if (!openSiblingFile(shpFile, filename_, "shp") ||
+        !openSiblingFile(shxFile, filename_, "shx") || shpFile.size() < shapefileHeaderSize ||
+        shxFile.size() < shapefileHeaderSize) {
+        return false;
+    }
+
+    std::size_t shxLength = 2 * static_cast<std::size_t>(
+                                    readBigEndian<std::uint32_t>(shxFile.data() + 24));
+    std::size_t shxSize = std::max(std::min(shxLength, shxFile.size()), shapefileHeaderSize);
+    int iNumOfEntities = static_cast<int>((shxSize - shapefileHeaderSize) / 8);
+
+    double pdMin[4] = {minX, minY, 0.0, 0.0};  // {x, y, z, m}
+    double pdMax[4] = {maxX, maxY, 0.0, 0.0};  // {x, y, z, m}
+
+    std::vector<int> candidates;
+    if (searchSpatialIndex(filename_, pdMin, pdMax, candidates)) {
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    } else {
+        // No index, bounding boxes of all records are read from their headers.
+        candidates.resize(iNumOfEntities);
+        for (int iEntityNumber = 0; iEntityNumber < iNumOfEntities; ++iEntityNumber) {
+            candidates[iEntityNumber] = iEntityNumber;
+        }
+    }
+
+    records.clear();
+    for (int iEntityNumber : candidates) {
+        if (iEntityNumber < 0 || iEntityNumber >= iNumOfEntities) {
+            continue;
+        }
+
+        std::size_t recordSize;
+        const unsigned char* record =
+            findRecordMapped(shpFile, shxFile, iEntityNumber, recordSize);
+        if (recordIntersectsRect(record, recordSize, pdMin, pdMax)) {
+            records.push_back(iEntityNumber);
+        }
+    }
+
     return true;
 }
 
-// bool GisShpFileReader::readFile(const std::string& sFileName) {
-//    filename_ = sFileName;
-//    return readFile();
-//}
+bool GisShpFileReader::readEntities(int threadsCount, const RecordReader& readRecord,
+                                    const std::vector<int>* records) {
+    // Lazy columns need the header only, geometry-only reads don't touch .dbf at all.
+    bool readAttributes = !lazyAttributes_ && !isGeometryOnly();
+    int dbfFilesCount = readAttributes ? threadsCount : (isGeometryOnly() ? 0 : 1);
+
+    // Open file in readonly mode, one handle per thread.
+    std::vector<DBFHandle> dbfFiles;
+    for (int iThreadNumber = 0; iThreadNumber < dbfFilesCount; ++iThreadNumber) {
+        DBFHandle dbfFile = DBFOpen(filename_.c_str(), "rb");
+        if (!dbfFile) {
+            break;
+        }
+        dbfFiles.push_back(dbfFile);
+    }
+
+    bool readResult = dbfFiles.size() == static_cast<std::size_t>(dbfFilesCount);
+
+    int iNumOfRecords = records ? static_cast<int>(records->size()) : iNumOfEntities_;
+    auto recordNumber = [&](int iRecordIndex) {
+        return records ? (*records)[iRecordIndex] : iRecordIndex;
+    };
+
+    std::vector<int> fields;
+    if (readResult && !dbfFiles.empty()) {
+        fields = projectedFields(dbfFieldNames(dbfFiles.front()));
+    }
+
+    // Read records with indexes [iFirstRecord, iLastRecord) appending them to entities.
+    auto readRange = [&](int iThreadNumber, int iFirstRecord, int iLastRecord,
+                         GisGeometryStore& geometry, GisAttributeTable& attributes,
+                         std::vector<GisEntity>& entities) {
+        std::size_t firstEntityIndex = entities.size();
+        for (int iRecordIndex = iFirstRecord; iRecordIndex < iLastRecord; ++iRecordIndex) {
+            std::size_t geometryIndex =
+                readRecord(iThreadNumber, recordNumber(iRecordIndex), geometry);
+            convertEntityPoints(geometry, geometryIndex);
+
+            entities.emplace_back();
+            entities.back().setGeometry(&geometry, geometryIndex);
+        }
+        // Envelopes are computed in the tasks, so merging just copies them.
+        geometry.updateEnvelopes();
+        if (!readAttributes) {
+            return;
+        }
+        for (int iRecordIndex = iFirstRecord; iRecordIndex < iLastRecord; ++iRecordIndex) {
+            entities[firstEntityIndex + (iRecordIndex - iFirstRecord)].setAttributes(
+                &attributes, readRecordAttributes(dbfFiles[iThreadNumber],
+                                                  recordNumber(iRecordIndex), fields,
+                                                  attributes));
+        }
+    };
+
+    if (readResult && readAttributes) {
+        fillAttributesSchema(dbfFiles.front(), fields, *attributes_);
+    } else if (readResult && !dbfFiles.empty()) {
+        auto source = std::make_shared<DbfRowsSource>();
+        source->filename = filename_;
+        if (records) {
+            source->records = *records;
+        }
+        fillLazyAttributesSchema(dbfFiles.front(), fields, source, *attributes_);
+    }
+
+    if (readResult && threadsCount == 1) {
+        entities_.reserve(iNumOfRecords);
+        attributes_->reserve(iNumOfRecords);
+
+        readRange(0, 0, iNumOfRecords, *geometry_, *attributes_, entities_);
+    } else if (readResult) {
+        // Several tasks per thread balance the load when records differ in size.
+        int recordsPerTask =
+            std::max(minRecordsPerTask, iNumOfRecords / (threadsCount * 8) + 1);
+        std::size_t tasksCount = (iNumOfRecords + recordsPerTask - 1) / recordsPerTask;
+
+        std::vector<GisGeometryStore> tasksGeometry(tasksCount);
+        std::vector<GisAttributeTable> tasksAttributes(tasksCount);
+        std::vector<std::vector<GisEntity>> tasksEntities(tasksCount);
+
+        gisParallelFor(tasksCount, threadsCount, [&](std::size_t iTaskNumber, int iThreadNumber) {
+            int iFirstRecord = static_cast<int>(iTaskNumber) * recordsPerTask;
+            int iLastRecord = std::min(iFirstRecord + recordsPerTask, iNumOfRecords);
+
+            if (readAttributes) {
+                fillAttributesSchema(dbfFiles[iThreadNumber], fields,
+                                     tasksAttributes[iTaskNumber]);
+            }
+            readRange(iThreadNumber, iFirstRecord, iLastRecord, tasksGeometry[iTaskNumber],
+                      tasksAttributes[iTaskNumber], tasksEntities[iTaskNumber]);
+        });
+
+        // Merge results in order of records.
+        std::size_t pointsCount = 0;
+        for (const auto& taskGeometry : tasksGeometry) {
+            pointsCount += taskGeometry.pointsCount();
+        }
+        entities_.reserve(iNumOfRecords);
+        geometry_->reserve(iNumOfRecords, pointsCount);
+        attributes_->reserve(iNumOfRecords);
+
+        for (std::size_t iTaskNumber = 0; iTaskNumber < tasksCount; ++iTaskNumber) {
+            std::size_t firstGeometryIndex = geometry_->append(tasksGeometry[iTaskNumber]);
+            std::size_t firstRow =
+                readAttributes ? attributes_->append(tasksAttributes[iTaskNumber]) : 0;
+
+            for (auto& entity : tasksEntities[iTaskNumber]) {
+                entity.setGeometry(geometry_.get(), firstGeometryIndex + entity.geometryIndex());
+                if (readAttributes) {
+                    entity.setAttributes(attributes_.get(), firstRow + entity.attributesRow());
+                }
+                entities_.push_back(std::move(entity));
+            }
+
+            // Release memory of the merged task right away to keep the peak low.
+            tasksGeometry[iTaskNumber] = GisGeometryStore();
+            tasksAttributes[iTaskNumber] = GisAttributeTable();
+            std::vector<GisEntity>().swap(tasksEntities[iTaskNumber]);
+        }
+    }
+
+    if (readResult && !readAttributes) {
+        // Rows of lazy columns follow order of records, so entities just take them in turn.
+        for (auto& entity : entities_) {
+            entity.setAttributes(attributes_.get(), attributes_->addRow());
+        }
+    }
+
+    if (readResult && pointsConverter_) {
+        // Extents of the header are in coordinates of the file.
+        fillLimitsFromGeometry();
+    }
+    if (readResult) {
+        geometry_->updateEnvelopes();
+    }
+
+    for (DBFHandle dbfFile : dbfFiles) {
+        DBFClose(dbfFile);
+    }
+
+    return readResult;
+}
+
+bool GisShpFileReader::visitEntities(const RecordReader& readRecord,
+                                     const EntityVisitor& visitor) {
+    // Open file in readonly mode, geometry-only reads don't need it.
+    DBFHandle dbfFile = nullptr;
+    if (!isGeometryOnly()) {
+        dbfFile = DBFOpen(filename_.c_str(), "rb");
+
+        if (!dbfFile) {
+            return false;
+        }
+    }
+
+    // The same store, table and entity are reused for every record.
+    GisGeometryStore geometry;
+    GisAttributeTable attributes;
+    GisEntity entity;
+
+    std::vector<int> fields;
+    if (dbfFile) {
+        fields = projectedFields(dbfFieldNames(dbfFile));
+        fillAttributesSchema(dbfFile, fields, attributes);
+    }
+
+    for (int iEntityNumber = 0; iEntityNumber < iNumOfEntities_; ++iEntityNumber) {
+        geometry.clear();
+        attributes.clearRows();
+        entity.setGeometry(&geometry, readRecord(0, iEntityNumber, geometry));
+        geometry.updateEnvelopes();
+        entity.setAttributes(&attributes,
+                             dbfFile ? readRecordAttributes(dbfFile, iEntityNumber, fields,
+                                                            attributes)
+                                     : attributes.addRow());
+
+        if (!visitor(entity)) {
+            break;
+        }
+    }
+
+    if (dbfFile) {
+        DBFClose(dbfFile);
+    }
+
+    return true;
+}
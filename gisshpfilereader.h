@@ -5,7 +5,9 @@
   This file contains declaration of class GisShpFileReader.
   */
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "gisfilereader.h"
 
@@ -14,7 +16,15 @@
  */
 class GisShpFileReader : public GisFileReader {
    public:
-    GisShpFileReader(const std::string& sFileName);
+    /**
+     * @brief Way of reading geometry from .shp file.
+     */
+    enum ReadMode {
+        ReadModeShapelib,     ///< Every record is read by SHPReadObject().
+        ReadModeMemoryMapped  ///< .shp and .shx are mapped and decoded in place.
+    };
+
+    GisShpFileReader(const std::string& sFileName, ReadMode readMode = ReadModeShapelib);
 
     /**
      * @brief Opens file by filename that was passed into constructor.
@@ -22,7 +32,144 @@ class GisShpFileReader : public GisFileReader {
      */
     virtual bool readFile();
 
+    /**
+     * @brief Read file record by record in the calling thread without storing
+     * entities.
+     * @param visitor - function called for every entity.
+     * @return True - if file was opened successfully. False - otherwise.
+     */
+    virtual bool forEachEntity(const EntityVisitor& visitor);
+
+    /**
+     * @brief Read only records whose bounding box intersects given rectangle.
+     * @details Candidate records are taken from .qix or .sbn spatial index if
+     * the shapefile has one, otherwise bounding boxes of all records are read
+     * from their headers. Only the selected records are decoded.
+     * @return True - if file was opened successfully. False - otherwise.
+     */
+    virtual bool readFileInRect(double minX, double minY, double maxX, double maxY);
+
+    /**
+     * @brief Build .qix spatial index of the shapefile and save it next to the
+     * .shp file, replacing existing one.
+     * @return True - if the index was written successfully. False - otherwise.
+     */
+    bool buildSpatialIndex();
+
+    /**
+     * @brief Check whether the shapefile has .qix or .sbn spatial index.
+     * @return True - if an index file exists and isn't older than .shp file.
+     * False - otherwise.
+     */
+    bool hasSpatialIndex() const;
+
+    bool autoBuildSpatialIndex() const;
+
+    /**
+     * @brief Set whether readFileInRect() builds .qix spatial index for
+     * shapefiles that don't have an up to date one.
+     * @details The index is built once, later windowed reads use it instead of
+     * scanning all records. readFile() reads all records and doesn't build it.
+     * Failure to write it (e.g. read-only directory) is remembered, so the
+     * build isn't tried again for the same file. Enabled by default.
+     * @param autoBuildSpatialIndex - true to build missing indexes.
+     */
+    void setAutoBuildSpatialIndex(bool autoBuildSpatialIndex);
+
+    bool lazyAttributes() const;
+
+    /**
+     * @brief Set whether fields are decoded from .dbf file on first access to
+     * their columns instead of while reading the file.
+     * @details Only the header of .dbf file is read by readFile() and
+     * readFileInRect(), a column is filled from the memory mapped file when any
+     * of its values is requested. Fields not used by the caller are never
+     * parsed. forEachEntity() always reads fields eagerly. Disabled by default.
+     * @param lazyAttributes - true to defer decoding of fields.
+     */
+    void setLazyAttributes(bool lazyAttributes);
+
+    ReadMode readMode() const;
+    void setReadMode(ReadMode readMode);
+
+    /**
+     * @brief Get number of threads that decode records.
+     * @return Number of threads, 0 means number of hardware threads.
+     */
+    int threadsCount() const;
+
+    /**
+     * @brief Set number of threads that decode records.
+     * @details Records are split into ranges that are decoded in parallel and
+     * merged in order of records, so the result doesn't depend on the number of
+     * threads. Value 1 (default) reads all records in the calling thread.
+     * @param threadsCount - number of threads, 0 means number of hardware threads.
+     */
+    void setThreadsCount(int threadsCount);
+
    private:
+    /**
+     * @brief Function that reads geometry of given record to given store using
+     * resources of given thread and returns index of the entity in the store.
+     */
+    using RecordReader =
+        std::function<std::size_t(int thread, int record, GisGeometryStore& geometry)>;
+
+    /**
+     * @brief Function that consumes all records of opened file using given
+     * RecordReader.
+     */
+    using RecordsConsumer = std::function<bool(const RecordReader& readRecord)>;
+
+    /**
+     * @brief Open .shp file with shapelib once per thread and pass records to
+     * readRecords.
+     * @param threadsCount - number of threads that will read records.
+     * @param readRecords - function that reads records.
+     * @return True - if files were opened and read successfully. False - otherwise.
+     */
+    bool readShapelib(int threadsCount, const RecordsConsumer& readRecords);
+
+    /**
+     * @brief Map .shp and .shx files and pass records decoded in place to
+     * readRecords.
+     * @param readRecords - function that reads records.
+     * @return True - if files were opened and read successfully. False - otherwise.
+     */
+    bool readMapped(const RecordsConsumer& readRecords);
+
+    /**
+     * @brief Find records whose bounding box intersects given rectangle.
+     * @param records - sorted numbers of found records.
+     * @return True - if .shp and .shx files were opened successfully. False - otherwise.
+     */
+    bool selectRecordsInRect(double minX, double minY, double maxX, double maxY,
+                             std::vector<int>& records) const;
+
+    /**
+     * @brief Fill entities_ with geometry and fields of records.
+     * @param threadsCount - number of threads to read records.
+     * @param readRecord - function to read geometry of a record.
+     * @param records - numbers of records to read, nullptr to read all records.
+     * @return True - if .dbf file was opened successfully or isn't needed.
+     * False - otherwise.
+     */
+    bool readEntities(int threadsCount, const RecordReader& readRecord,
+                      const std::vector<int>* records = nullptr);
+
+    /**
+     * @brief Pass all records to visitor one by one reusing the same entity.
+     * @param readRecord - function to read geometry of a record.
+     * @param visitor - function called for every entity.
+     * @return True - if .dbf file was opened successfully. False - otherwise.
+     */
+    bool visitEntities(const RecordReader& readRecord, const EntityVisitor& visitor);
+
     int iShapeType_;
     int iNumOfEntities_;
+    ReadMode readMode_;
+    int threadsCount_;
+    bool autoBuildSpatialIndex_;
+    std::string spatialIndexFailedFilename_;  // file whose index couldn't be built
+    bool lazyAttributes_;
 };
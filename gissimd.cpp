@@ -0,0 +1,38 @@
+#include "gissimd.h"
+
+#if defined(GIS_AVX2_KERNEL) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+bool cpuSupportsAvx2() {
+#if !defined(GIS_AVX2_KERNEL)
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // FMA, OSXSAVE and AVX bits, then YMM state enabled by the system.
+    __cpuid(info, 1);
+    const int requiredBits = (1 << 12) | (1 << 27) | (1 << 28);
+    if ((info[2] & requiredBits) != requiredBits || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+} // namespace
+
+bool gisCpuSupportsAvx2() {
+    static const bool supported = cpuSupportsAvx2();
+    return supported;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/**
+  @file
+  This file contains macros and functions for kernels with AVX2 instructions.
+  GIS_AVX2_KERNEL is defined on x86 processors, where functions marked with
+  GIS_TARGET_AVX2 may use AVX2 and FMA if gisCpuSupportsAvx2() returns true.
+  */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GIS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+#if defined(GIS_AVX2_KERNEL) && defined(__GNUC__)
+#define GIS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define GIS_TARGET_AVX2
+#endif
+
+/**
+ * @brief Check whether the processor and the system support AVX2 and FMA.
+ * @return True - if kernels marked with GIS_TARGET_AVX2 can run. False - otherwise.
+ */
+bool gisCpuSupportsAvx2();
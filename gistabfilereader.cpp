@@ -2,7 +2,9 @@
 
 #include "mitab.h"
 
-#include <set>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 namespace {
 
@@ -20,47 +22,112 @@ std::string& clearFromWhitespaces(std::string& s) {
 
 
     /**
-     * @brief Get list of fields from feature.
-     * @param feature - OGRFeature from which we get fields.
-     * @return List of fields from feature.
+     * @brief Get names of all fields of the layer.
+     * @param featureDefn - definition of features of the layer.
+     * @return Names of the fields in order of the layer.
      */
-std::list<GisField> featureFields(OGRFeature* feature) {
-    std::list<GisField> fields;
+std::vector<std::string> featureFieldNames(OGRFeatureDefn* featureDefn) {
+    std::vector<std::string> fieldNames;
 
-    for (int i = 0; i < feature->GetFieldCount(); i++) {
-        std::string fieldName = feature->GetFieldDefnRef(i)->GetNameRef();
-        OGRFieldType fieldType = feature->GetFieldDefnRef(i)->GetType();
+    for (int i = 0; i < featureDefn->GetFieldCount(); i++) {
+        fieldNames.push_back(featureDefn->GetFieldDefn(i)->GetNameRef());
+    }
 
-        std::string fieldValue;
+    return fieldNames;
+}
 
-        // Translate to needed data type from given
-        switch (fieldType) {
+    /**
+     * @brief Describe columns of attributes by fields of the layer.
+     * @param featureDefn - definition of features of the layer.
+     * @param fields - indices of the fields to describe.
+     * @param attributes - GisAttributeTable without columns.
+     */
+void fillAttributesSchema(OGRFeatureDefn* featureDefn, const std::vector<int>& fields,
+                          GisAttributeTable& attributes) {
+    for (int i : fields) {
+        OGRFieldDefn* fieldDefn = featureDefn->GetFieldDefn(i);
+
+        switch (fieldDefn->GetType()) {
             case OFTInteger:
-                fieldValue = std::to_string(feature->GetFieldAsInteger(i));
+                attributes.addColumn(fieldDefn->GetNameRef(), GisAttributeTable::FieldTypeInteger);
                 break;
-            case OFTString:
-                fieldValue = feature->GetFieldAsString(i);
+            case OFTReal:
+                // Decimal fields have width and precision, float fields have neither.
+                attributes.addColumn(fieldDefn->GetNameRef(), GisAttributeTable::FieldTypeDouble,
+                                     fieldDefn->GetWidth() > 0 ? fieldDefn->GetPrecision() : -1);
+                break;
+            case OFTDate:
+                attributes.addColumn(fieldDefn->GetNameRef(), GisAttributeTable::FieldTypeDate);
                 break;
             default:
+                attributes.addColumn(fieldDefn->GetNameRef(), GisAttributeTable::FieldTypeString);
                 break;
         }
+    }
+}
 
-        fields.emplace_back(fieldName, clearFromWhitespaces(fieldValue));
+    /**
+     * @brief Append fields of feature as a new row of attributes.
+     * @param attributes - GisAttributeTable with columns filled by fillAttributesSchema().
+     * @param feature - OGRFeature from which we get fields.
+     * @param fields - indices of the fields of the columns.
+     * @param fieldValue - buffer for string values of the fields.
+     * @return Index of the row inside of the attribute table.
+     */
+std::size_t readFeatureAttributes(GisAttributeTable& attributes, OGRFeature* feature,
+                                  const std::vector<int>& fields, std::string& fieldValue) {
+    std::size_t row = attributes.addRow();
+
+    for (std::size_t column = 0; column < fields.size(); column++) {
+        int i = fields[column];
+        if (!feature->IsFieldSet(i)) {
+            continue;
+        }
+
+        // Translate to needed data type from given
+        switch (attributes.columnType(column)) {
+            case GisAttributeTable::FieldTypeInteger:
+                attributes.setInt(row, column, feature->GetFieldAsInteger(i));
+                break;
+            case GisAttributeTable::FieldTypeDouble:
+                attributes.setDouble(row, column, feature->GetFieldAsDouble(i));
+                break;
+            case GisAttributeTable::FieldTypeDate: {
+                int year;
+                int month;
+                int day;
+                int unused;
+                if (feature->GetFieldAsDateTime(i, &year, &month, &day, &unused, &unused, &unused,
+                                                &unused)) {
+                    attributes.setDate(row, column, year, month, day);
+                }
+                break;
+            }
+            case GisAttributeTable::FieldTypeString:
+                fieldValue = feature->GetFieldAsString(i);
+                attributes.setString(row, column, clearFromWhitespaces(fieldValue));
+                break;
+        }
     }
 
-    return fields;
+    return row;
 }
 
     /**
-     * @brief Get list of points from feature.
-     * @param feature - OGRFeature from which we get fields.
-     * @return List of points from feature.
+     * @brief Append points from feature as a new entity of the geometry store.
+     * @param geometryStore - GisGeometryStore of the layer.
+     * @param feature - OGRFeature from which we get points.
+     * @return Index of the entity inside of the geometry store.
      */
-std::list<GAPoint> featurePoints(OGRFeature* feature) {
-    std::list<GAPoint> points;
+std::size_t featurePoints(GisGeometryStore& geometryStore, OGRFeature* feature) {
+    std::size_t geometryIndex = geometryStore.beginEntity();
 
     OGRGeometry* geometry = feature->GetGeometryRef();
 
+    if (!geometry) {
+        return geometryIndex;
+    }
+
     // If entity is polygon then cast it to OGRPolygon type and eject points.
     if (geometry->getGeometryType() == wkbPolygon) {
         auto* polygon = static_cast<OGRPolygon*>(geometry);
@@ -68,13 +135,63 @@ std::list<GAPoint> featurePoints(OGRFeature* feature) {
         OGRLinearRing* linearRing = polygon->getExteriorRing();
 
         for (int indexPoint = 0; indexPoint < linearRing->getNumPoints(); indexPoint++) {
-            points.emplace_back(linearRing->getX(indexPoint), linearRing->getY(indexPoint));
+            geometryStore.addPoint(linearRing->getX(indexPoint), linearRing->getY(indexPoint));
         }
     }
 
-    return points;
+    return geometryIndex;
 }
 
+/**
+ * @brief Running min/max of bounding boxes of features.
+ */
+class LimitsAccumulator {
+   public:
+    LimitsAccumulator()
+        : minX_(std::numeric_limits<double>::max()),
+          minY_(std::numeric_limits<double>::max()),
+          maxX_(std::numeric_limits<double>::lowest()),
+          maxY_(std::numeric_limits<double>::lowest()) {}
+
+    /**
+     * @brief Extend limits by bounding box of the feature.
+     * @param feature - feature to add, features without geometry are skipped.
+     */
+    void add(TABFeature* feature) {
+        if (!feature->GetGeometryRef()) {
+            return;
+        }
+
+        double featureMinX;
+        double featureMaxX;
+        double featureMinY;
+        double featureMaxY;
+        feature->GetMBR(featureMinX, featureMinY, featureMaxX, featureMaxY);
+
+        minX_ = std::min(minX_, featureMinX);
+        minY_ = std::min(minY_, featureMinY);
+        maxX_ = std::max(maxX_, featureMaxX);
+        maxY_ = std::max(maxY_, featureMaxY);
+    }
+
+    /**
+     * @brief Get accumulated limits, zeros if no feature had geometry.
+     */
+    void fill(double& minX, double& minY, double& maxX, double& maxY) const {
+        bool isEmpty = minX_ > maxX_;
+        minX = isEmpty ? 0.0 : minX_;
+        minY = isEmpty ? 0.0 : minY_;
+        maxX = isEmpty ? 0.0 : maxX_;
+        maxY = isEmpty ? 0.0 : maxY_;
+    }
+
+   private:
+    double minX_;
+    double minY_;
+    double maxX_;
+    double maxY_;
+};
+
 } // namespace
 
 GisTabFileReader::GisTabFileReader(const std::string& filename)
@@ -87,51 +204,213 @@ bool GisTabFileReader::readFile() {
     mapInfoFile_ = IMapInfoFile::SmartOpen(filename_.c_str());
 
     if (mapInfoFile_) {
+        clearClipHistory();
         entities_.clear();
-
-        fillLimitsCoordinates();
+        geometry_->clear();
+        attributes_->clear();
+        fields_ = projectedFields(featureFieldNames(mapInfoFile_->GetLayerDefn()));
+        fillAttributesSchema(mapInfoFile_->GetLayerDefn(), fields_, *attributes_);
+
+        // Extents of the header are in coordinates of the file, with a
+        // converter they come from envelopes of converted entities.
+        bool fillLimits = !fillLimitsFromHeader();
         fillEntities();
 
+        if (fillLimits || pointsConverter_) {
+            fillLimitsFromGeometry();
+        }
+
         return true;
     }
 
     return false;
 }
 
+bool GisTabFileReader::readFileInRect(double minX, double minY, double maxX, double maxY) {
+
+    delete mapInfoFile_;
+
+    mapInfoFile_ = IMapInfoFile::SmartOpen(filename_.c_str());
+
+    if (!mapInfoFile_) {
+        return false;
+    }
+
+    clearClipHistory();
+    entities_.clear();
+    geometry_->clear();
+    attributes_->clear();
+    fields_ = projectedFields(featureFieldNames(mapInfoFile_->GetLayerDefn()));
+    fillAttributesSchema(mapInfoFile_->GetLayerDefn(), fields_, *attributes_);
+
+    // With a converter extents are computed from converted points instead.
+    if (!fillLimitsFromHeader() && !pointsConverter_) {
+        fillLimitsCoordinates();
+    }
+
+    std::string fieldValue;
+
+    visitFeaturesInRect(minX, minY, maxX, maxY, [&](OGRFeature* feature) {
+        std::size_t geometryIndex = featurePoints(*geometry_, feature);
+        convertEntityPoints(*geometry_, geometryIndex);
+
+        entities_.emplace_back();
+        entities_.back().setGeometry(geometry_.get(), geometryIndex);
+        entities_.back().setAttributes(
+            attributes_.get(), readFeatureAttributes(*attributes_, feature, fields_, fieldValue));
+
+        return true;
+    });
+
+    geometry_->updateEnvelopes();
+    if (pointsConverter_) {
+        fillLimitsFromGeometry();
+    }
+
+    return true;
+}
+
+bool GisTabFileReader::fillLimitsFromHeader() {
+    OGREnvelope extent;
+
+    if (mapInfoFile_->GetExtent(&extent, FALSE) != OGRERR_NONE) {
+        return false;
+    }
+
+    minX_ = extent.MinX;
+    maxX_ = extent.MaxX;
+    minY_ = extent.MinY;
+    maxY_ = extent.MaxY;
+
+    return true;
+}
+
 void GisTabFileReader::fillLimitsCoordinates() {
     // Find min and max x and y from all boundaries from the map.
+    LimitsAccumulator limits;
 
-    std::set<double> xValues;
-    std::set<double> yValues;
+    int featureId = -1;
+    while ((featureId = mapInfoFile_->GetNextFeatureId(featureId)) != -1) {
+        TABFeature* feature = mapInfoFile_->GetFeatureRef(featureId);
+
+        if (!feature) {
+            break;
+        }
+        limits.add(feature);
+    }
+
+    limits.fill(minX_, minY_, maxX_, maxY_);
+}
 
-    for (int i = 1; i <= mapInfoFile_->GetFeatureCount(1); i++) {
-        TABFeature* feature = mapInfoFile_->GetFeatureRef(i);
-        double minX;
-        double maxX;
-        double minY;
-        double maxY;
-        feature->GetMBR(minX, minY, maxX, maxY);
+bool GisTabFileReader::forEachEntity(const EntityVisitor& visitor) {
 
-        xValues.insert(minX);
-        yValues.insert(minY);
+    delete mapInfoFile_;
+
+    mapInfoFile_ = IMapInfoFile::SmartOpen(filename_.c_str());
+
+    if (!mapInfoFile_) {
+        return false;
     }
 
-    minX_ = *xValues.begin();
-    maxX_ = *xValues.rbegin();
-    minY_ = *yValues.begin();
-    maxY_ = *yValues.rbegin();
+    // The same store, table, entity and buffer are reused for every feature.
+    GisGeometryStore geometry;
+    GisAttributeTable attributes;
+    GisEntity entity;
+    std::string fieldValue;
+
+    std::vector<int> fields = projectedFields(featureFieldNames(mapInfoFile_->GetLayerDefn()));
+    fillAttributesSchema(mapInfoFile_->GetLayerDefn(), fields, attributes);
+
+    visitFeatures([&](OGRFeature* feature) {
+        geometry.clear();
+        attributes.clearRows();
+        entity.setGeometry(&geometry, featurePoints(geometry, feature));
+        geometry.updateEnvelopes();
+        entity.setAttributes(&attributes,
+                             readFeatureAttributes(attributes, feature, fields, fieldValue));
+
+        return visitor(entity);
+    });
+
+    return true;
 }
 
 void GisTabFileReader::fillEntities() {
-    // Return to the begin of the file
-    mapInfoFile_->ResetReading();
+    std::string fieldValue;
 
     // Move around all features, fill GisEntity structure and add it to
     // entities_.
-    while (OGRFeature* feature = mapInfoFile_->GetNextFeature()) {
-        std::list<GisField> fields = featureFields(feature);
-        std::list<GAPoint> points = featurePoints(feature);
-        entities_.emplace_back(fields, points);
+    visitFeatures([&](OGRFeature* feature) {
+        std::size_t geometryIndex = featurePoints(*geometry_, feature);
+        convertEntityPoints(*geometry_, geometryIndex);
+
+        entities_.emplace_back();
+        entities_.back().setGeometry(geometry_.get(), geometryIndex);
+        entities_.back().setAttributes(
+            attributes_.get(), readFeatureAttributes(*attributes_, feature, fields_, fieldValue));
+
+        return true;
+    });
+
+    geometry_->updateEnvelopes();
+}
+
+void GisTabFileReader::visitFeatures(const std::function<bool(OGRFeature*)>& visitor) {
+    // Features are taken by reference, they are owned and reused by mapInfoFile_.
+    int featureId = -1;
+    while ((featureId = mapInfoFile_->GetNextFeatureId(featureId)) != -1) {
+        OGRFeature* feature = mapInfoFile_->GetFeatureRef(featureId);
+
+        if (!feature) {
+            break;
+        }
+        if (!visitor(feature)) {
+            break;
+        }
     }
 }
 
+
+void GisTabFileReader::visitFeaturesInRect(double minX, double minY, double maxX, double maxY,
+                                           const std::function<bool(OGRFeature*)>& visitor) {
+    // With the filter set, ids come from the index blocks of the .MAP file that
+    // intersect the rectangle instead of the whole .ID file.
+    mapInfoFile_->SetSpatialFilterRect(minX, minY, maxX, maxY);
+
+    std::vector<int> featureIds;
+    int featureId = -1;
+    while ((featureId = mapInfoFile_->GetNextFeatureId(featureId)) != -1) {
+        featureIds.push_back(featureId);
+    }
+
+    mapInfoFile_->SetSpatialFilter(nullptr);
+
+    // The tree returns ids in arbitrary order, keep order of the file.
+    std::sort(featureIds.begin(), featureIds.end());
+
+    for (int id : featureIds) {
+        TABFeature* feature = mapInfoFile_->GetFeatureRef(id);
+
+        if (!feature) {
+            break;
+        }
+        if (!feature->GetGeometryRef()) {
+            continue;
+        }
+
+        // Index blocks are checked by their bounds only.
+        double featureMinX;
+        double featureMaxX;
+        double featureMinY;
+        double featureMaxY;
+        feature->GetMBR(featureMinX, featureMinY, featureMaxX, featureMaxY);
+
+        if (featureMinX > maxX || featureMaxX < minX || featureMinY > maxY ||
+            featureMaxY < minY) {
+            continue;
+        }
+        if (!visitor(feature)) {
+            break;
+        }
+    }
+}
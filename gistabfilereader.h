@@ -5,11 +5,14 @@
   This file contains declaration of class GisTabFileReader.
   */
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "gisfilereader.h"
 
 class IMapInfoFile;
+class OGRFeature;
 
 /**
  * @brief Class that allows you to get information from .tab file.
@@ -24,18 +27,57 @@ class GisTabFileReader : public GisFileReader {
      */
     virtual bool readFile();
 
+    /**
+     * @brief Read file feature by feature without storing entities.
+     * @param visitor - function called for every entity.
+     * @return True - if file was opened successfully. False - otherwise.
+     */
+    virtual bool forEachEntity(const EntityVisitor& visitor);
+
+    /**
+     * @brief Read only features whose bounding box intersects given rectangle.
+     * @details Candidate features are found by walking only the index blocks
+     * of the .MAP file R-tree that intersect the rectangle.
+     * @return True - if file was opened successfully. False - otherwise.
+     */
+    virtual bool readFileInRect(double minX, double minY, double maxX, double maxY);
+
    private:
     /**
      * @brief Initializes maxX_, maxY_, minX_, minY_ which derived from
-     * GisFileReader.
+     * GisFileReader by bounding boxes of all features.
      */
     void fillLimitsCoordinates();
 
+    /**
+     * @brief Initializes maxX_, maxY_, minX_, minY_ with extent of the data
+     * stored in header of the .MAP file.
+     * @return True - if the file has the extent in header. False - otherwise.
+     */
+    bool fillLimitsFromHeader();
+
     /**
      * @brief Fill GisFileReader::entities() with points and fields by data from
-     * mapInfoFile_.
+     * mapInfoFile_ and compute envelopes of the entities.
      */
     void fillEntities();
 
+    /**
+     * @brief Pass all features of mapInfoFile_ to visitor.
+     * @param visitor - function called for every feature, returns False to stop.
+     */
+    void visitFeatures(const std::function<bool(OGRFeature*)>& visitor);
+
+    /**
+     * @brief Pass features of mapInfoFile_ whose bounding box intersects the
+     * rectangle to visitor in order of their ids.
+     * @param visitor - function called for every feature, returns False to stop.
+     */
+    void visitFeaturesInRect(double minX, double minY, double maxX, double maxY,
+                             const std::function<bool(OGRFeature*)>& visitor);
+
     IMapInfoFile* mapInfoFile_;
+
+    // Indices of the fields of features stored in columns of attributes_.
+    std::vector<int> fields_;
 };
@@ -9,6 +9,7 @@
 #include <QScrollBar>
 #include <QWheelEvent>
 #include <QFileDialog>
+#include <QProgressDialog>
 #include <QStyle>
 #include <QScreen>
 
@@ -16,6 +17,47 @@ static const int converterDefaultZoneNum_ = 35;
 static const bool converterDefaultIsNorth_ = true;
 static constexpr double mapCenterDefaultLongitude = 27;
 static constexpr double mapCenterDefaultLatitude = 51;
+// Maximal error of approximate conversion on the map, 1 cm.
+static constexpr double converterTolerance = 0.01;
+
+static QPolygonF pointsPolygon(const GisPointsSpan &points) {
+    QPolygonF poly;
+    poly.reserve(static_cast<int>(points.size()));
+    for (const GAPoint &point : points) {
+        poly.push_back(QPointF(point.x(), point.y()));
+    }
+
+    return poly;
+}
+
+static QPolygonF entityPolygon(const GisEntity &entity) { return pointsPolygon(entity.points()); }
+
+// Distance in pixels from the first vertex of the lasso at which a click closes it.
+static constexpr int lassoCloseDistance = 8;
+
+static QBrush mapBrush() { return QBrush(QRgb(0xb5a87c)); }
+
+static QBrush highlightBrush() { return QBrush(QRgb(0xe0c060)); }
+
+static QPen clippingPen() {
+    QPen pen(QBrush(QColor(0x0182b8)), 2);
+    pen.setCosmetic(true);
+
+    return pen;
+}
+
+static QBrush clippingBrush() {
+    QColor colorBrush(0x0182b8);
+    colorBrush.setAlpha(50);
+
+    return QBrush(colorBrush);
+}
+
+// Envelope of the rectangle the same way GisFileReader::clipPolygons() takes it.
+static GisEnvelope rectEnvelope(const QRectF &rect) {
+    return GisEnvelope(std::min(rect.left(), rect.right()), std::min(rect.top(), rect.bottom()),
+                       std::max(rect.left(), rect.right()), std::max(rect.top(), rect.bottom()));
+}
 
 MainWidget::MainWidget(QWidget *parent)
     : QWidget(parent),
@@ -24,15 +66,19 @@ MainWidget::MainWidget(QWidget *parent)
       diameterPrimitives_(0),
       scene_(new QGraphicsScene(this)),
       clippingRectItem_(nullptr),
+      lassoItem_(nullptr),
       trajectoryBeginItem_(nullptr),
       trajectoryEndItem_(nullptr),
       trajectoryLineItem_(nullptr),
+      highlightedItem_(-1),
       mode_(ModeTrajectorySelecting) {
     ui->setupUi(this);
     windowToCenter();
 
     ui->radioTrajectory->setChecked(true);
     ui->radioClipping->setChecked(false);
+    ui->radioLasso->setChecked(false);
+    ui->radioIdentify->setChecked(false);
 
     ui->lineGeoCenterLong->setValidator(new QDoubleValidator(-180, 180, 5));
     ui->lineGeoCenterLat->setValidator(new QDoubleValidator(-90, 90, 5));
@@ -89,7 +135,8 @@ bool MainWidget::processEventViewportMouse(QEvent *event) {
     if (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::MouseButtonRelease ||
         event->type() == QEvent::MouseMove) {
         auto *mouseEvent = static_cast<QMouseEvent *>(event);
-        if (mouseEvent->button() == Qt::LeftButton) {
+        // Move events carry no button, they are handled whatever buttons are held.
+        if (mouseEvent->button() == Qt::LeftButton || mouseEvent->type() == QEvent::MouseMove) {
             switch (mouseEvent->type()) {
                 case QEvent::MouseButtonPress:
                     isMousePressed = true;
@@ -113,6 +160,12 @@ bool MainWidget::processEventViewportMouse(QEvent *event) {
                                     addClippingBeginPoint(mouseEvent->pos());
                                 }
                                 break;
+                            case ModeLassoClipping:
+                                addLassoPoint(mouseEvent->pos());
+                                break;
+                            case ModeIdentify:
+                                identifyEntity(mouseEvent->pos());
+                                break;
                         }
                     }
                     break;
@@ -131,6 +184,10 @@ bool MainWidget::processEventViewportMouse(QEvent *event) {
                         lastMousePressPosY = mouseEvent->y();
                     } else if (mode_ == ModeMapClipping && clippingRectItem_) {
                         addClippingEndPoint(mouseEvent->pos());
+                    } else if (mode_ == ModeLassoClipping && lassoItem_) {
+                        moveLassoEndPoint(mouseEvent->pos());
+                    } else if (mode_ == ModeIdentify) {
+                        highlightEntityAt(mouseEvent->pos());
                     }
 
                     break;
@@ -173,27 +230,48 @@ void MainWidget::drawMap() {
     pen.setCosmetic(true);
 
     for (const GisEntity &entity : readerConvertDecorator_->entities()) {
-        QPolygonF poly;
-        for (const GAPoint &point : entity.points()) {
-            poly.push_back(QPointF(point.x(), point.y()));
-        }
-        mapItems_.push_back(scene_->addPolygon(poly, pen, QBrush(QRgb(0xb5a87c))));
+        mapItems_.push_back(
+            scene_->addPolygon(entityPolygon(entity), pen, mapBrush()));
+    }
+}
+
+bool MainWidget::updateMapItems() {
+    const std::vector<GisEntity> &entities = readerConvertDecorator_->entities();
+
+    if (static_cast<std::size_t>(mapItems_.size()) != entities.size()) {
+        return false;
+    }
+
+    // Items keep their pens, brushes and z-order, only the geometry changes.
+    for (std::size_t i = 0; i < entities.size(); ++i) {
+        mapItems_[static_cast<int>(i)]->setPolygon(entityPolygon(entities[i]));
     }
+
+    return true;
 }
 
 void MainWidget::clearMap() {
+    // The clip preview refers to the items and entities, it is stopped first.
+    clearClippingItems();
+    clearTrajectoryItems();
+    clearHighlight();
+    ui->textEntityFields->clear();
+
     for (QGraphicsPolygonItem *mapItem : mapItems_) {
         delete mapItem;
     }
     mapItems_.clear();
-
-    clearClippingItems();
-    clearTrajectoryItems();
 }
 
 void MainWidget::clearClippingItems() {
+    resetClipPreview();
+
     delete clippingRectItem_;
     clippingRectItem_ = nullptr;
+
+    delete lassoItem_;
+    lassoItem_ = nullptr;
+    lasso_.clear();
 }
 
 void MainWidget::clearTrajectoryItems() {
@@ -208,17 +286,18 @@ void MainWidget::clearTrajectoryItems() {
 }
 
 void MainWidget::fitViewUnderCurrentMap() {
-    QRectF mapRect(QPointF(readerConvertDecorator_->minX(), readerConvertDecorator_->minY()),
-                   QPointF(readerConvertDecorator_->maxX(), readerConvertDecorator_->maxY()));
+    GisEnvelope envelope = readerConvertDecorator_->envelope();
+    QRectF mapRect(QPointF(envelope.minX(), envelope.minY()),
+                   QPointF(envelope.maxX(), envelope.maxY()));
 
     ui->graphicsView->fitInView(mapRect, Qt::KeepAspectRatio);
 
     // drawCurrentMapBoundingRect();
 
-    qDebug() << "Map min X:" << QString::number(readerConvertDecorator_->minX(), 'f', 2)
-             << "Map max X:" << QString::number(readerConvertDecorator_->maxX(), 'f', 2)
-             << "Map min Y:" << QString::number(readerConvertDecorator_->minY(), 'f', 2)
-             << "Map max Y:" << QString::number(readerConvertDecorator_->maxY(), 'f', 2);
+    qDebug() << "Map min X:" << QString::number(envelope.minX(), 'f', 2)
+             << "Map max X:" << QString::number(envelope.maxX(), 'f', 2)
+             << "Map min Y:" << QString::number(envelope.minY(), 'f', 2)
+             << "Map max Y:" << QString::number(envelope.maxY(), 'f', 2);
 }
 
 void MainWidget::drawCurrentMapBoundingRect() {
@@ -240,11 +319,10 @@ void MainWidget::readMap(const QString &filename) {
     }
 
     readerConvertDecorator_->setGisFileReader(fileReader);
-    readerConvertDecorator_->readFile();
+    fileReader->readFile();
 
-    for (auto &entity : readerConvertDecorator_->entities()) {
-        qDebug() << QString::fromStdString(entity.fieldsToString()) << entity.points().size();
-    }
+    // Converter is fitted to the extent of the layer before points are converted.
+    updateConverter();
 }
 
 void MainWidget::calculateDiameterPrimitives(double sizeFactor) {
@@ -260,17 +338,20 @@ void MainWidget::addClippingBeginPoint(const QPoint &point) {
 
 void MainWidget::addClippingEndPoint(const QPoint &point) {
     clippingRect_.setBottomRight(ui->graphicsView->mapToScene(point));
-    clearClippingItems();
 
-    QBrush brushPen(QColor(0x0182b8));
-    QPen pen(brushPen, 2);
-    pen.setCosmetic(true);
-
-    QColor colorBrush(0x0182b8);
-    colorBrush.setAlpha(50);
-    QBrush brush(colorBrush);
+    // The item follows the cursor while the preview clips the map in the background.
+    if (clippingRectItem_) {
+        clippingRectItem_->setRect(clippingRect_);
+    } else {
+        clippingRectItem_ = scene_->addRect(clippingRect_, clippingPen(), clippingBrush());
+    }
 
-    clippingRectItem_ = scene_->addRect(clippingRect_, pen, brush);
+    if (!clipPreview_) {
+        startClipPreview();
+    }
+    if (clipPreview_) {
+        clipPreview_->requestClip(rectEnvelope(clippingRect_));
+    }
 }
 
 void MainWidget::clipMap() {
@@ -279,12 +360,223 @@ void MainWidget::clipMap() {
     ui->lineClipBottomRightX->setText(QString::number(clippingRect_.bottomRight().x(), 'f', 5));
     ui->lineClipBottomRightY->setText(QString::number(clippingRect_.bottomRight().y(), 'f', 5));
 
-    readerConvertDecorator_->clipPolygons(clippingRect_.x(), clippingRect_.y(),
-                                          clippingRect_.right(), clippingRect_.bottom());
+    // If the preview caught up with the rectangle, its items already show the clipped map.
+    applyClipPreview();
+    bool isPreviewCurrent = clipPreview_ && previewRectangle_ == rectEnvelope(clippingRect_) &&
+                            readerConvertDecorator_->clipMethod() ==
+                                GisFileReader::ClipMethodRectangle;
+    clipPreview_.reset();
+
+    bool clipped = clipWithProgress([this](const GisFileReader::ClipProgress &progress) {
+        return readerConvertDecorator_->clipPolygons(clippingRect_.x(), clippingRect_.y(),
+                                                     clippingRect_.right(),
+                                                     clippingRect_.bottom(), progress);
+    });
+    if (!clipped) {
+        resetClipPreview();
+        return;
+    }
+
+    if (isPreviewCurrent) {
+        // Clipped entities keep their order, so visible items become items of the new entities.
+        QList<QGraphicsPolygonItem *> clippedItems;
+        for (int i = 0; i < mapItems_.size(); ++i) {
+            if (previewKinds_[static_cast<std::size_t>(i)] == GisClipPreview::KindOutside) {
+                delete mapItems_[i];
+            } else {
+                clippedItems.push_back(mapItems_[i]);
+            }
+        }
+        mapItems_.swap(clippedItems);
+    }
+    // Items don't show the old entities any more, there is nothing to restore.
+    previewKinds_.clear();
+
+    if (isPreviewCurrent) {
+        clearClippingItems();
+    } else {
+        clearMap();
+        drawMap();
+    }
+}
+
+void MainWidget::addLassoPoint(const QPoint &point) {
+    // The last vertex follows the cursor, the others are fixed by clicks.
+    if (lasso_.size() > 3) {
+        QPoint firstPoint = ui->graphicsView->mapFromScene(lasso_.front());
+        if ((firstPoint - point).manhattanLength() <= lassoCloseDistance) {
+            lasso_.pop_back();
+            clipMapByLasso();
+            return;
+        }
+    }
+
+    QPointF scenePoint = ui->graphicsView->mapToScene(point);
+    if (lasso_.isEmpty()) {
+        lasso_.push_back(scenePoint);
+    } else {
+        lasso_.back() = scenePoint;
+    }
+    lasso_.push_back(scenePoint);
+
+    if (lassoItem_) {
+        lassoItem_->setPolygon(lasso_);
+    } else {
+        lassoItem_ = scene_->addPolygon(lasso_, clippingPen(), clippingBrush());
+    }
+}
+
+void MainWidget::moveLassoEndPoint(const QPoint &point) {
+    lasso_.back() = ui->graphicsView->mapToScene(point);
+    lassoItem_->setPolygon(lasso_);
+}
+
+void MainWidget::clipMapByLasso() {
+    std::vector<GAPoint> clipArea;
+    clipArea.reserve(static_cast<std::size_t>(lasso_.size()));
+    for (const QPointF &point : lasso_) {
+        clipArea.push_back(GAPoint(point.x(), point.y()));
+    }
+
+    bool clipped = clipWithProgress([this, &clipArea](const GisFileReader::ClipProgress &progress) {
+        return readerConvertDecorator_->clipPolygons(clipArea, progress);
+    });
+    if (!clipped) {
+        clearClippingItems();
+        return;
+    }
+
     clearMap();
     drawMap();
 }
 
+bool MainWidget::clipWithProgress(
+    const std::function<bool(const GisFileReader::ClipProgress &)> &clip) {
+    // The dialog shows up only if clipping takes long, its events are processed on every step.
+    QProgressDialog progressDialog("Clipping map...", "Cancel", 0, 100, this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(500);
+
+    return clip([&progressDialog](std::size_t entitiesDone, std::size_t entitiesCount) {
+        progressDialog.setValue(static_cast<int>(100 * entitiesDone / entitiesCount));
+        return !progressDialog.wasCanceled();
+    });
+}
+
+int MainWidget::entityItemAt(const QPoint &point) {
+    const std::vector<GisEntity> &entities = readerConvertDecorator_->entities();
+    if (static_cast<std::size_t>(mapItems_.size()) != entities.size()) {
+        return -1;
+    }
+
+    QPointF pointMapped = ui->graphicsView->mapToScene(point);
+    std::size_t entityIndex = 0;
+    if (!readerConvertDecorator_->entityAt(pointMapped.x(), pointMapped.y(), entityIndex)) {
+        return -1;
+    }
+
+    return static_cast<int>(entityIndex);
+}
+
+void MainWidget::highlightEntityAt(const QPoint &point) {
+    int itemIndex = entityItemAt(point);
+    if (itemIndex == highlightedItem_) {
+        return;
+    }
+
+    clearHighlight();
+    if (itemIndex >= 0) {
+        mapItems_[itemIndex]->setBrush(highlightBrush());
+        highlightedItem_ = itemIndex;
+    }
+}
+
+void MainWidget::clearHighlight() {
+    if (highlightedItem_ >= 0 && highlightedItem_ < mapItems_.size()) {
+        mapItems_[highlightedItem_]->setBrush(mapBrush());
+    }
+    highlightedItem_ = -1;
+}
+
+void MainWidget::identifyEntity(const QPoint &point) {
+    int itemIndex = entityItemAt(point);
+    if (itemIndex < 0) {
+        ui->textEntityFields->clear();
+        return;
+    }
+
+    const GisEntity &entity =
+        readerConvertDecorator_->entities()[static_cast<std::size_t>(itemIndex)];
+    ui->textEntityFields->setPlainText(QString::fromStdString(entity.fieldsToString()));
+}
+
+void MainWidget::startClipPreview() {
+    const std::vector<GisEntity> &entities = readerConvertDecorator_->entities();
+    if (entities.empty() || static_cast<std::size_t>(mapItems_.size()) != entities.size()) {
+        return;
+    }
+
+    previewKinds_.assign(entities.size(), GisClipPreview::KindInside);
+    previewRectangle_ = GisEnvelope();
+
+    // Results are applied in the GUI thread.
+    const GisRTree &tree = readerConvertDecorator_->entitiesTree();
+    clipPreview_.reset(new GisClipPreview(entities, tree, [this]() {
+        QMetaObject::invokeMethod(this, "applyClipPreview", Qt::QueuedConnection);
+    }));
+}
+
+void MainWidget::applyClipPreview() {
+    GisClipPreview::Result result;
+    if (!clipPreview_ || !clipPreview_->takeResult(result)) {
+        return;
+    }
+
+    const std::vector<GisEntity> &entities = readerConvertDecorator_->entities();
+
+    // Only changed items are updated, so the cost follows the changed strips.
+    for (std::size_t i = 0; i < result.entities.size(); ++i) {
+        std::size_t entityIndex = result.entities[i];
+        QGraphicsPolygonItem *mapItem = mapItems_[static_cast<int>(entityIndex)];
+
+        switch (result.kinds[i]) {
+            case GisClipPreview::KindInside:
+                if (previewKinds_[entityIndex] == GisClipPreview::KindClipped) {
+                    mapItem->setPolygon(entityPolygon(entities[entityIndex]));
+                }
+                mapItem->show();
+                break;
+            case GisClipPreview::KindOutside:
+                mapItem->hide();
+                break;
+            case GisClipPreview::KindClipped:
+                mapItem->setPolygon(
+                    pointsPolygon(result.geometry->points(result.geometryIndices[i])));
+                mapItem->show();
+                break;
+        }
+        previewKinds_[entityIndex] = result.kinds[i];
+    }
+
+    previewRectangle_ = result.rectangle;
+}
+
+void MainWidget::resetClipPreview() {
+    clipPreview_.reset();
+
+    // Items show whole entities again.
+    const std::vector<GisEntity> &entities = readerConvertDecorator_->entities();
+    for (std::size_t i = 0; i < previewKinds_.size(); ++i) {
+        QGraphicsPolygonItem *mapItem = mapItems_[static_cast<int>(i)];
+
+        if (previewKinds_[i] == GisClipPreview::KindClipped) {
+            mapItem->setPolygon(entityPolygon(entities[i]));
+        }
+        mapItem->show();
+    }
+    previewKinds_.clear();
+}
+
 void MainWidget::addTrajectoryPoint(const QPoint &point) {
     QPointF pointMapped = ui->graphicsView->mapToScene(point);
 
@@ -342,9 +634,20 @@ void MainWidget::updateTrajectoryDataGui() {
 }
 
 void MainWidget::updateConverter(double mapCenterLongitude, double mapCenterLatitude) {
-    readerConvertDecorator_->setCoordinatesConverter(
-        new GisCoordinatesConverterSimple(mapCenterLongitude, mapCenterLatitude));
-    readerConvertDecorator_->readFile();
+    auto *converter =
+        new GisCoordinatesConverterApproximate(mapCenterLongitude, mapCenterLatitude);
+
+    // Grids are fitted to the layer in degrees, without them conversion is exact.
+    GisFileReader *fileReader = readerConvertDecorator_->gisFileReader();
+    if (fileReader && !fileReader->entities().empty()) {
+        converter->fit(fileReader->minX(), fileReader->minY(), fileReader->maxX(),
+                       fileReader->maxY(), converterTolerance);
+    }
+
+    readerConvertDecorator_->setCoordinatesConverter(converter);
+
+    // Source coordinates are kept in memory, the file isn't read again.
+    readerConvertDecorator_->reproject();
 }
 
 void MainWidget::updateConverter() {
@@ -368,9 +671,17 @@ void MainWidget::showCursorCoordinates(const QPoint &point) {
 }
 
 void MainWidget::redrawMapAfterChangeCenter() {
+    // Clipping and trajectory are in the old projection, the clip preview must
+    // stop before entities change.
+    clearClippingItems();
+    clearTrajectoryItems();
+
     updateConverter();
-    clearMap();
-    drawMap();
+
+    if (!updateMapItems()) {
+        clearMap();
+        drawMap();
+    }
 }
 void MainWidget::on_lineGeoCenterLong_editingFinished() { redrawMapAfterChangeCenter(); }
 
@@ -379,14 +690,39 @@ void MainWidget::on_lineGeoCenterLat_editingFinished() { redrawMapAfterChangeCen
 void MainWidget::on_radioTrajectory_clicked() {
     mode_ = ModeTrajectorySelecting;
     clearClippingItems();
+    clearHighlight();
 }
 
 void MainWidget::on_radioClipping_clicked() {
     mode_ = ModeMapClipping;
+    clearClippingItems();
     clearTrajectoryItems();
+    clearHighlight();
+}
+
+void MainWidget::on_radioLasso_clicked() {
+    mode_ = ModeLassoClipping;
+    clearClippingItems();
+    clearTrajectoryItems();
+    clearHighlight();
+}
+
+void MainWidget::on_radioIdentify_clicked() {
+    mode_ = ModeIdentify;
+    clearClippingItems();
+    clearTrajectoryItems();
+
+    // The tree is built now, so the first move of the cursor isn't delayed by it.
+    readerConvertDecorator_->entitiesTree();
 }
 
 void MainWidget::on_pushRestoreMap_clicked() {
+    clearClippingItems();
+    if (readerConvertDecorator_->clipLevelsCount() == 0) {
+        return;
+    }
+
+    // Every click steps back one clip.
     readerConvertDecorator_->restorePolygons();
     clearClippingRectangleLines();
     clearMap();
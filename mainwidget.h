@@ -2,8 +2,14 @@
 
 #include <QWidget>
 #include <QList>
+#include <QPolygonF>
 
-#include "giscoordinatesconvertersimple.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "gisclippreview.h"
+#include "giscoordinatesconverterapproximate.h"
 #include "gisfilereaderconvertdecorator.h"
 #include "gisfilereaders.h"
 
@@ -19,7 +25,7 @@ class QGraphicsEllipseItem;
 
 class MainWidget : public QWidget {
 
-    enum Mode { ModeTrajectorySelecting, ModeMapClipping };
+    enum Mode { ModeTrajectorySelecting, ModeMapClipping, ModeLassoClipping, ModeIdentify };
 
     Q_OBJECT
 
@@ -36,11 +42,15 @@ class MainWidget : public QWidget {
     void on_lineGeoCenterLat_editingFinished();
     void on_radioTrajectory_clicked();
     void on_radioClipping_clicked();
+    void on_radioLasso_clicked();
+    void on_radioIdentify_clicked();
     void on_pushRestoreMap_clicked();
+    void applyClipPreview();
 
    private:
     void windowToCenter();
     void drawMap();
+    bool updateMapItems();
     void clearMap();
     void clearClippingItems();
     void clearTrajectoryItems();
@@ -51,6 +61,16 @@ class MainWidget : public QWidget {
     void addClippingBeginPoint(const QPoint &point);
     void addClippingEndPoint(const QPoint &point);
     void clipMap();
+    void addLassoPoint(const QPoint &point);
+    void moveLassoEndPoint(const QPoint &point);
+    void clipMapByLasso();
+    bool clipWithProgress(const std::function<bool(const GisFileReader::ClipProgress &)> &clip);
+    int entityItemAt(const QPoint &point);
+    void highlightEntityAt(const QPoint &point);
+    void clearHighlight();
+    void identifyEntity(const QPoint &point);
+    void startClipPreview();
+    void resetClipPreview();
     void addTrajectoryPoint(const QPoint &point);
     void addTrajectoryPointBegin(const QPointF &point);
     void addTrajectoryPointEnd(const QPointF &point);
@@ -72,8 +92,14 @@ class MainWidget : public QWidget {
     QGraphicsScene *scene_;
     QList<QGraphicsPolygonItem *> mapItems_;
     QGraphicsRectItem *clippingRectItem_;
+    QPolygonF lasso_;  // vertices of the lasso, the last one follows the cursor
+    QGraphicsPolygonItem *lassoItem_;
     QGraphicsEllipseItem *trajectoryBeginItem_;
     QGraphicsEllipseItem *trajectoryEndItem_;
     QGraphicsLineItem *trajectoryLineItem_;
+    int highlightedItem_;  // index of the item under the cursor in identify mode, -1 if none
     Mode mode_;
+    std::unique_ptr<GisClipPreview> clipPreview_;
+    std::vector<GisClipPreview::Kind> previewKinds_;  // state of every item in the preview
+    GisEnvelope previewRectangle_;                    // rectangle of the shown preview
 };